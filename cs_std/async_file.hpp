@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <filesystem>
+#include "file.hpp"
+#include "coroutine.hpp"
+
+namespace cs_std
+{
+	// Async versions of the file read paths, the read itself runs on one of the queue's threads and the awaiting
+	// coroutine continues there once the data is ready, so no thread is dedicated to each outstanding load
+	// A file object must only have one read in flight at a time, use the path overloads for independent loads
+
+	inline co_task<std::vector<byte>> async_read(task_queue& queue, binary_file& file, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		co_return file.read();
+	}
+	inline co_task<std::vector<byte>> async_read(task_queue& queue, binary_file& file, size_t start, size_t count, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		co_return file.read(start, count);
+	}
+	inline co_task<std::string> async_read(task_queue& queue, text_file& file, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		co_return file.read();
+	}
+	inline co_task<std::string> async_read(task_queue& queue, text_file& file, size_t start, size_t count, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		co_return file.read(start, count);
+	}
+	// Opens, reads and closes the file on the queue
+	inline co_task<std::vector<byte>> async_read_binary(task_queue& queue, std::filesystem::path filePath, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		binary_file file(filePath);
+		co_return file.open().read();
+	}
+	inline co_task<std::string> async_read_text(task_queue& queue, std::filesystem::path filePath, task_priority priority = task_priority::normal)
+	{
+		co_await queue.schedule(priority);
+		text_file file(filePath);
+		co_return file.open().read();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+namespace cs_std
+{
+	// Assumed destructive interference size, used to keep independently written atomics on separate cache lines
+	inline constexpr size_t CACHE_LINE_SIZE = 64;
+}
\ No newline at end of file
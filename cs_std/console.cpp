@@ -1,4 +1,12 @@
 #include "console.hpp"
+#include "log_ring.hpp"
+#include <span>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
 
 namespace cs_std
 {
@@ -8,14 +16,492 @@ namespace cs_std
 		return 0;
 	}();
 
-	bool console::enableThreadSafety = true;
+	std::atomic<bool> console::enableThreadSafety = true;
 	std::mutex console::threadMutex;
-	console::severity console::displayedSeverities =
+	std::atomic<console::severity> console::displayedSeverities =
 		static_cast<uint8_t>(console::severity_bits::info) |
 		static_cast<uint8_t>(console::severity_bits::log) |
 		static_cast<uint8_t>(console::severity_bits::warn) |
 		static_cast<uint8_t>(console::severity_bits::error) |
 		static_cast<uint8_t>(console::severity_bits::fatal);
-	bool console::printSeverity = true, console::printTimestamp = true;
-	std::chrono::time_point<std::chrono::steady_clock> console::timePoint = std::chrono::high_resolution_clock::now();
-}
\ No newline at end of file
+	std::atomic<bool> console::printSeverity = true, console::printTimestamp = true, console::printElapsed = false;
+	thread_local std::chrono::high_resolution_clock::time_point console::timePoint = std::chrono::high_resolution_clock::now();
+	std::atomic<bool> console::asyncEnabled = false;
+	std::atomic<uint64_t> console::limitInterval = 0, console::limitBurst = 1;
+	std::atomic<log_site*> console::limitedSites = nullptr;
+
+	namespace
+	{
+		typedef std::vector<std::shared_ptr<log_sink>> sink_list;
+
+		struct sink_registry
+		{
+			// Serialises changes to the list, log calls only ever load it
+			std::mutex mutex;
+			std::atomic<std::shared_ptr<const sink_list>> sinks;
+			std::shared_ptr<log_sink> standardOutput = std::make_shared<stdout_sink>();
+			// Sink from open_binary_log, and whether stdout was taken off for it
+			std::shared_ptr<log_sink> binaryLog;
+			bool replacedStandardOutput = false;
+
+			sink_registry() { this->sinks.store(std::make_shared<const sink_list>(1, this->standardOutput)); }
+			bool contains(const std::shared_ptr<log_sink>& sink) const
+			{
+				std::shared_ptr<const sink_list> list = this->sinks.load(std::memory_order_acquire);
+				return std::find(list->begin(), list->end(), sink) != list->end();
+			}
+		};
+		// Leaked like the standard streams, so log calls made by static destructors in other translation units still find it
+		sink_registry& registry()
+		{
+			static sink_registry* instance = new sink_registry();
+			return *instance;
+		}
+
+		struct thread_log
+		{
+			log_ring ring;
+			// Set once the owning thread exits, the buffer is freed after the writer has drained it
+			std::atomic<bool> orphaned = false;
+
+			explicit thread_log(size_t bytes) : ring(bytes) {}
+		};
+		// Buffers a thread reuses from one log call to the next
+		struct log_scratch
+		{
+			// Record being made outside async mode, it goes straight to the sinks on commit
+			std::vector<std::byte> direct;
+			// Per thread copy of the signature table so records do not take its lock
+			std::vector<const std::vector<log_arg_type>*> signatures;
+			std::string text;
+		};
+		// Owned by the thread, trivially destructible so log calls from destructors that run after the thread's own still work
+		struct log_owner
+		{
+			thread_log* log = nullptr;
+			log_scratch* scratch = nullptr;
+			// Record too large for the ring, it travels through the ring as a pointer to this size prefixed copy
+			std::byte* large = nullptr;
+			bool isDirect = false;
+			// Record going through the ring with thread safety off, the logging threads drain the rings themselves
+			bool isMerged = false;
+		};
+		thread_local log_owner localLog;
+		// Flags the thread's buffer for freeing and frees its scratch when the thread exits
+		// Log calls made after that set up new ones, which are only reclaimed with the process
+		struct log_owner_release
+		{
+			~log_owner_release()
+			{
+				if (localLog.log != nullptr) std::exchange(localLog.log, nullptr)->orphaned.store(true, std::memory_order_release);
+				delete std::exchange(localLog.scratch, nullptr);
+			}
+		};
+		thread_local log_owner_release localRelease;
+
+		log_scratch& local_scratch()
+		{
+			if (localLog.scratch != nullptr) return *localLog.scratch;
+			// Naming it constructs the release for this thread
+			static_cast<void>(localRelease);
+			localLog.scratch = new log_scratch();
+			return *localLog.scratch;
+		}
+
+		// Formats the record once for every text sink that accepts it
+		void dispatch(std::span<const std::byte> record)
+		{
+			log_scratch& scratch = local_scratch();
+			log_record_header header;
+			std::memcpy(&header, record.data(), sizeof(header));
+			std::shared_ptr<const sink_list> sinks = registry().sinks.load(std::memory_order_acquire);
+			bool formatted = false;
+			for (const std::shared_ptr<log_sink>& sink : *sinks)
+			{
+				if (!sink->accepts(header.severity)) continue;
+				if (sink->wants_records())
+				{
+					sink->write_record(record);
+					continue;
+				}
+				if (!formatted)
+				{
+					while (header.signature >= scratch.signatures.size()) scratch.signatures.push_back(&log_signatures::get(static_cast<uint32_t>(scratch.signatures.size())));
+					scratch.text.clear();
+					internal::log_append_text(scratch.text, header, *scratch.signatures[header.signature], record.data() + sizeof(header));
+					formatted = true;
+				}
+				sink->write(header, scratch.text);
+			}
+		}
+		void flush_sinks()
+		{
+			std::shared_ptr<const sink_list> sinks = registry().sinks.load(std::memory_order_acquire);
+			for (const std::shared_ptr<log_sink>& sink : *sinks) sink->flush();
+		}
+
+
+		struct log_writer
+		{
+			// Serialises async() calls
+			std::mutex controlMutex;
+			// Guards the buffer list, and makes the writer thread the only consumer of every buffer
+			std::mutex registryMutex;
+			std::vector<std::unique_ptr<thread_log>> logs;
+			std::atomic<size_t> bufferBytes = size_t(1) << 20;
+			std::atomic<console::overflow_policy> policy = console::overflow_policy::block;
+			std::atomic<uint64_t> dropped = 0;
+			// Bumped to wake the writer, it only sleeps on it after announcing so through sleeping
+			std::atomic<uint32_t> signal = 0;
+			std::atomic<bool> sleeping = false;
+			std::atomic<bool> stopping = false;
+			std::atomic<bool> running = false;
+			std::atomic<uint64_t> flushRequested = 0;
+			std::atomic<uint64_t> flushCompleted = 0;
+			// Set while a logging thread drains the buffers with thread safety off
+			std::atomic<bool> merging = false;
+			// Oldest record of each buffer while draining, guarded by registryMutex
+			std::vector<std::span<const std::byte>> heads;
+			std::thread thread;
+
+			void wake()
+			{
+				this->signal.fetch_add(1, std::memory_order_release);
+				this->signal.notify_one();
+			}
+			bool has_records()
+			{
+				std::lock_guard<std::mutex> lock(this->registryMutex);
+				for (const auto& log : this->logs)
+				{
+					if (!log->ring.empty()) return true;
+				}
+				return false;
+			}
+			// Whether the writer has anything left to do, called with sleeping set
+			bool pending(uint64_t flushTarget)
+			{
+				if (this->stopping.load(std::memory_order_seq_cst) || this->flushRequested.load(std::memory_order_seq_cst) != flushTarget) return true;
+				return this->has_records();
+			}
+			// Writes out what is buffered and joins the thread, later log calls write directly
+			void stop()
+			{
+				console::async(false);
+				if (!this->running.load(std::memory_order_acquire)) return;
+				this->stopping.store(true, std::memory_order_seq_cst);
+				this->wake();
+				this->thread.join();
+				this->running.store(false, std::memory_order_release);
+			}
+		};
+		// Leaked for the same reason as the registry, only its thread is stopped at exit
+		log_writer& writer()
+		{
+			static log_writer* instance = new log_writer();
+			return *instance;
+		}
+		struct writer_shutdown
+		{
+			~writer_shutdown() { writer().stop(); }
+		};
+		writer_shutdown writerShutdown;
+
+		thread_log& local_log()
+		{
+			if (localLog.log != nullptr) return *localLog.log;
+			static_cast<void>(localRelease);
+			std::lock_guard<std::mutex> lock(writer().registryMutex);
+			std::unique_ptr<thread_log> log = std::make_unique<thread_log>(writer().bufferBytes.load(std::memory_order_relaxed));
+			localLog.log = log.get();
+			writer().logs.push_back(std::move(log));
+			return *localLog.log;
+		}
+		// Applies the overflow policy when the ring is full
+		std::byte* reserve_in(thread_log& log, size_t size)
+		{
+			std::byte* data = log.ring.reserve(size);
+			if (data != nullptr) return data;
+			if (writer().policy.load(std::memory_order_relaxed) == console::overflow_policy::block)
+			{
+				for (; data == nullptr; data = log.ring.reserve(size))
+				{
+					writer().wake();
+					std::this_thread::yield();
+				}
+				return data;
+			}
+			writer().dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		// Every real record is larger than its header, so a pointer sized one stands in for a large record
+		bool is_large(std::span<const std::byte> record) { return record.size() == sizeof(std::byte*); }
+		std::span<const std::byte> resolve(std::span<const std::byte> record)
+		{
+			if (!is_large(record)) return record;
+			std::byte* large;
+			size_t size;
+			std::memcpy(&large, record.data(), sizeof(large));
+			std::memcpy(&size, large, sizeof(size));
+			return { large + sizeof(size_t), size };
+		}
+		uint64_t record_time(std::span<const std::byte> record)
+		{
+			log_record_header header;
+			std::memcpy(&header, resolve(record).data(), sizeof(header));
+			return header.time;
+		}
+		// Writes out every record in the buffers oldest first across threads, called with the registry and console locks held
+		// Before a record is written the buffers that looked empty are checked again, a record committed before it was made
+		// is visible by then and would come first, so lines that depend on each other keep their order
+		bool drain_logs()
+		{
+			std::vector<std::span<const std::byte>>& heads = writer().heads;
+			bool drained = false;
+			while (true)
+			{
+				heads.resize(writer().logs.size());
+				size_t oldest = heads.size();
+				uint64_t oldestTime = 0;
+				for (size_t i = 0; i < heads.size(); i++)
+				{
+					heads[i] = writer().logs[i]->ring.peek();
+					if (heads[i].empty()) continue;
+					uint64_t time = record_time(heads[i]);
+					if (oldest != heads.size() && time >= oldestTime) continue;
+					oldest = i;
+					oldestTime = time;
+				}
+				if (oldest == heads.size()) break;
+				bool earlier = false;
+				for (size_t i = 0; i < heads.size() && !earlier; i++)
+				{
+					if (!heads[i].empty()) continue;
+					std::span<const std::byte> late = writer().logs[i]->ring.peek();
+					earlier = !late.empty() && record_time(late) < oldestTime;
+				}
+				if (earlier) continue;
+				dispatch(resolve(heads[oldest]));
+				if (is_large(heads[oldest])) delete[] (resolve(heads[oldest]).data() - sizeof(size_t));
+				writer().logs[oldest]->ring.pop();
+				drained = true;
+			}
+			// Checked before emptiness, every record a thread made before exiting is visible once it is seen as orphaned
+			std::erase_if(writer().logs, [](const std::unique_ptr<thread_log>& log) { return log->orphaned.load(std::memory_order_acquire) && log->ring.empty(); });
+			return drained;
+		}
+	}
+
+	std::byte* console::reserve_record(size_t size)
+	{
+		bool async = asyncEnabled.load(std::memory_order_relaxed);
+		if (!async && enableThreadSafety.load(std::memory_order_relaxed))
+		{
+			std::vector<std::byte>& direct = local_scratch().direct;
+			direct.resize(size);
+			localLog.isDirect = true;
+			return direct.data();
+		}
+		localLog.isMerged = !async;
+		thread_log& log = local_log();
+		if (size <= log.ring.max_record_size()) return reserve_in(log, size);
+		localLog.large = new std::byte[sizeof(size_t) + size];
+		std::memcpy(localLog.large, &size, sizeof(size));
+		return localLog.large + sizeof(size_t);
+	}
+	void console::commit_record()
+	{
+		if (localLog.isDirect)
+		{
+			localLog.isDirect = false;
+			std::scoped_lock lock(threadMutex);
+			dispatch(localLog.scratch->direct);
+			return;
+		}
+		thread_log& log = *localLog.log;
+		if (localLog.large != nullptr)
+		{
+			std::byte* large = std::exchange(localLog.large, nullptr);
+			std::byte* data = reserve_in(log, sizeof(large));
+			if (data == nullptr)
+			{
+				delete[] large;
+				return;
+			}
+			std::memcpy(data, &large, sizeof(large));
+		}
+		log.ring.commit();
+		if (std::exchange(localLog.isMerged, false)) merge_logs();
+		else if (writer().sleeping.load(std::memory_order_seq_cst)) writer().wake();
+	}
+	void console::merge_logs()
+	{
+		// Some other thread is draining, it looks at the buffers again after clearing the flag so it will see this record
+		// Sequentially consistent like the commit before it, either this load or that second look sees the other side
+		if (writer().merging.load(std::memory_order_seq_cst)) return;
+		while (!writer().merging.exchange(true, std::memory_order_seq_cst))
+		{
+			{
+				std::scoped_lock lock(writer().registryMutex, threadMutex);
+				drain_logs();
+			}
+			writer().merging.store(false, std::memory_order_seq_cst);
+			if (!writer().has_records()) return;
+		}
+	}
+	void console::run_writer()
+	{
+		std::vector<std::byte> dropRecord;
+		bool unflushed = false;
+		uint64_t reportedDrops = 0;
+		auto drain = [&]() {
+			// Sinks are only ever called under the console's lock, direct calls can still be made while the writer drains
+			std::scoped_lock lock(writer().registryMutex, threadMutex);
+			return drain_logs();
+		};
+
+		while (true)
+		{
+			// Read before draining, so every record made before these requests is written by this pass
+			uint64_t flushTarget = writer().flushRequested.load(std::memory_order_seq_cst);
+			bool stopping = writer().stopping.load(std::memory_order_seq_cst);
+			bool drained = drain();
+			unflushed |= drained;
+			uint64_t dropped = writer().dropped.load(std::memory_order_relaxed);
+			if (dropped != reportedDrops && writer().policy.load(std::memory_order_relaxed) == overflow_policy::count)
+			{
+				auto values = internal::log_encodables(dropped - reportedDrops, " log messages were dropped");
+				dropRecord.resize(internal::log_record_size(values));
+				internal::log_write_record(dropRecord.data(), log_record_header{ internal::log_now(), log_signatures::id<uint64_t, const char*>(), static_cast<uint8_t>(severity_bits::warn), static_cast<uint8_t>(record_flags() | log_record_flags::severity), 0 }, values);
+				std::scoped_lock lock(threadMutex);
+				dispatch(dropRecord);
+				unflushed = true;
+			}
+			reportedDrops = dropped;
+			if (writer().flushCompleted.load(std::memory_order_relaxed) != flushTarget || (!drained && unflushed))
+			{
+				{
+					std::scoped_lock lock(threadMutex);
+					flush_sinks();
+				}
+				unflushed = false;
+				writer().flushCompleted.store(flushTarget, std::memory_order_release);
+				writer().flushCompleted.notify_all();
+			}
+			if (drained) continue;
+			if (stopping) break;
+			uint32_t value = writer().signal.load(std::memory_order_acquire);
+			writer().sleeping.store(true, std::memory_order_seq_cst);
+			if (!writer().pending(flushTarget)) writer().signal.wait(value, std::memory_order_acquire);
+			writer().sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+	void console::async(bool enable, overflow_policy policy, size_t threadBufferBytes)
+	{
+		std::lock_guard<std::mutex> lock(writer().controlMutex);
+		writer().policy.store(policy, std::memory_order_relaxed);
+		writer().bufferBytes.store(threadBufferBytes, std::memory_order_relaxed);
+		if (!enable)
+		{
+			// Later calls write directly again, what was already buffered goes out first
+			if (asyncEnabled.exchange(false, std::memory_order_relaxed)) flush();
+			return;
+		}
+		// The writer has already shut down for exit
+		if (writer().stopping.load(std::memory_order_relaxed)) return;
+		if (!writer().running.load(std::memory_order_acquire))
+		{
+			writer().thread = std::thread(run_writer);
+			writer().running.store(true, std::memory_order_release);
+		}
+		asyncEnabled.store(true, std::memory_order_relaxed);
+	}
+	void console::flush()
+	{
+		for (log_site* site = limitedSites.load(std::memory_order_acquire); site != nullptr; site = site->next) report_suppressed(*site);
+		if (writer().running.load(std::memory_order_acquire))
+		{
+			uint64_t target = writer().flushRequested.fetch_add(1, std::memory_order_seq_cst) + 1;
+			writer().wake();
+			for (uint64_t done = writer().flushCompleted.load(std::memory_order_acquire); done < target; done = writer().flushCompleted.load(std::memory_order_acquire)) writer().flushCompleted.wait(done, std::memory_order_acquire);
+		}
+		// Output made directly, or left in the buffers by threads logging with thread safety off
+		std::scoped_lock lock(writer().registryMutex, threadMutex);
+		drain_logs();
+		flush_sinks();
+	}
+	uint64_t console::dropped_messages() { return writer().dropped.load(std::memory_order_relaxed); }
+	void console::rate_limit(double perSecond, uint32_t burst)
+	{
+		limitBurst.store(burst == 0 ? 1 : burst, std::memory_order_relaxed);
+		limitInterval.store(perSecond > 0 ? static_cast<uint64_t>(1e9 / perSecond) : 0, std::memory_order_relaxed);
+	}
+	void console::list_site(log_site& site)
+	{
+		if (site.listed.exchange(true, std::memory_order_relaxed)) return;
+		// Sites are statics and never removed, so a lock-free push is all the list needs
+		log_site* head = limitedSites.load(std::memory_order_relaxed);
+		do site.next = head;
+		while (!limitedSites.compare_exchange_weak(head, &site, std::memory_order_release, std::memory_order_relaxed));
+	}
+	void console::report_suppressed(log_site& site)
+	{
+		uint64_t count = site.suppressed.exchange(0, std::memory_order_relaxed);
+		if (count == 0) return;
+		const char* name = site.file;
+		for (const char* c = site.file; *c != '\0'; c++)
+		{
+			if (*c == '/' || *c == '\\') name = c + 1;
+		}
+		base_log(static_cast<severity_bits>(site.severity), "Suppressed ", count, count == 1 ? " message from " : " messages from ", name, ":", site.line);
+	}
+	void console::attach(std::shared_ptr<log_sink> sink)
+	{
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		std::shared_ptr<const sink_list> current = registry().sinks.load(std::memory_order_acquire);
+		if (sink == nullptr || std::find(current->begin(), current->end(), sink) != current->end()) return;
+		std::shared_ptr<sink_list> next = std::make_shared<sink_list>(*current);
+		next->push_back(std::move(sink));
+		registry().sinks.store(std::move(next), std::memory_order_release);
+	}
+	void console::detach(const std::shared_ptr<log_sink>& sink)
+	{
+		// Everything logged before this call still reaches the sink
+		flush();
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		std::shared_ptr<const sink_list> current = registry().sinks.load(std::memory_order_acquire);
+		std::shared_ptr<sink_list> next = std::make_shared<sink_list>(*current);
+		next->erase(std::remove(next->begin(), next->end(), sink), next->end());
+		registry().sinks.store(std::move(next), std::memory_order_release);
+	}
+	const std::shared_ptr<log_sink>& console::standard_output() { return registry().standardOutput; }
+	bool console::open_binary_log(const std::filesystem::path& filePath)
+	{
+		std::shared_ptr<binary_file_sink> sink = std::make_shared<binary_file_sink>(filePath);
+		if (!sink->is_open()) return false;
+		close_binary_log();
+		// Messages logged before this still go to where they were headed
+		flush();
+		bool replaced = registry().contains(registry().standardOutput);
+		attach(sink);
+		if (replaced) detach(registry().standardOutput);
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		registry().binaryLog = std::move(sink);
+		registry().replacedStandardOutput = replaced;
+		return true;
+	}
+	void console::close_binary_log()
+	{
+		std::shared_ptr<log_sink> sink;
+		bool replaced;
+		{
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			sink = std::exchange(registry().binaryLog, nullptr);
+			replaced = std::exchange(registry().replacedStandardOutput, false);
+		}
+		if (sink == nullptr) return;
+		detach(sink);
+		if (replaced) attach(registry().standardOutput);
+	}
+}
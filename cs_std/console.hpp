@@ -1,9 +1,69 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <filesystem>
 #include <type_traits>
+#include "log_record.hpp"
+#include "log_sink.hpp"
+
+// Severities below CS_CONSOLE_MIN_SEVERITY are compiled out, define it to one of the levels below before including this header
+// The CS_ macros then expand to nothing and skip evaluating their arguments, the console functions become empty
+#define CS_CONSOLE_SEVERITY_VERBOSE 0
+#define CS_CONSOLE_SEVERITY_INFO 1
+#define CS_CONSOLE_SEVERITY_LOG 2
+#define CS_CONSOLE_SEVERITY_WARN 3
+#define CS_CONSOLE_SEVERITY_ERROR 4
+#define CS_CONSOLE_SEVERITY_FATAL 5
+#ifndef CS_CONSOLE_MIN_SEVERITY
+#define CS_CONSOLE_MIN_SEVERITY CS_CONSOLE_SEVERITY_VERBOSE
+#endif
+
+// Arguments of the macros are only evaluated if the severity is displayed, a filtered out call costs one relaxed load
+// Each expansion has its own log_site, so console::rate_limit applies per call site
+#define CS_CONSOLE_SITE_CALL(level, perSecond, burst, ...) do { \
+	if (cs_std::console::enabled(cs_std::console::severity_bits::level)) { \
+		static constinit cs_std::log_site csConsoleSite(__FILE__, __LINE__, static_cast<uint8_t>(cs_std::console::severity_bits::level), perSecond, burst); \
+		if (cs_std::console::admit(csConsoleSite)) cs_std::console::level(__VA_ARGS__); \
+	} } while (0)
+#define CS_CONSOLE_CALL(level, ...) CS_CONSOLE_SITE_CALL(level, 0, 0, __VA_ARGS__)
+// Rate limits this call site to perSecond messages with bursts of up to burst, whatever console::rate_limit is set to
+// Level is one of verbose, info, log, warn, error or fatal, perSecond and burst must be constants
+#define CS_RATE_LIMITED(level, perSecond, burst, ...) CS_CONSOLE_SITE_CALL(level, perSecond, burst, __VA_ARGS__)
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_VERBOSE
+#define CS_VERBOSE(...) CS_CONSOLE_CALL(verbose, __VA_ARGS__)
+#else
+#define CS_VERBOSE(...) ((void)0)
+#endif
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_INFO
+#define CS_INFO(...) CS_CONSOLE_CALL(info, __VA_ARGS__)
+#else
+#define CS_INFO(...) ((void)0)
+#endif
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_LOG
+#define CS_LOG(...) CS_CONSOLE_CALL(log, __VA_ARGS__)
+#else
+#define CS_LOG(...) ((void)0)
+#endif
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_WARN
+#define CS_WARN(...) CS_CONSOLE_CALL(warn, __VA_ARGS__)
+#else
+#define CS_WARN(...) ((void)0)
+#endif
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_ERROR
+#define CS_ERROR(...) CS_CONSOLE_CALL(error, __VA_ARGS__)
+#else
+#define CS_ERROR(...) ((void)0)
+#endif
+#if CS_CONSOLE_MIN_SEVERITY <= CS_CONSOLE_SEVERITY_FATAL
+#define CS_FATAL(...) CS_CONSOLE_CALL(fatal, __VA_ARGS__)
+#else
+#define CS_FATAL(...) ((void)0)
+#endif
 
 namespace cs_std
 {
@@ -15,6 +75,39 @@ namespace cs_std
 		std::is_convertible_v<T, std::chrono::minutes> ||
 		std::is_convertible_v<T, std::chrono::hours>;
 
+	/// <summary>
+	/// Rate limit state of one CS_ macro call site, a token bucket kept as the time it will be full again
+	/// Taking a token is one load and one compare exchange, a suppressed call one load and one fetch add, neither takes a lock
+	/// </summary>
+	class log_site
+	{
+	public:
+		const char* file;
+		uint32_t line;
+		uint8_t severity;
+		// Own limit of the site, zero takes console::rate_limit's
+		uint64_t interval;
+		uint64_t burst;
+		// Time in nanoseconds, on the log_now clock, the bucket is full again at, more than burst - 1 intervals ahead means empty
+		std::atomic<uint64_t> refilled = 0;
+		std::atomic<uint64_t> suppressed = 0;
+		// Sites that have suppressed a message are listed for console::flush to report
+		std::atomic<bool> listed = false;
+		log_site* next = nullptr;
+
+		constexpr log_site(const char* file, uint32_t line, uint8_t severity, double perSecond = 0, uint32_t burst = 0) :
+			file(file), line(line), severity(severity), interval(perSecond > 0 ? static_cast<uint64_t>(1e9 / perSecond) : 0), burst(burst == 0 ? 1 : burst) {}
+		bool take(uint64_t now, uint64_t tokenInterval, uint64_t tokens)
+		{
+			uint64_t full = this->refilled.load(std::memory_order_relaxed);
+			do
+			{
+				if (full > now + (tokens - 1) * tokenInterval) return false;
+			} while (!this->refilled.compare_exchange_weak(full, (full > now ? full : now) + tokenInterval, std::memory_order_relaxed));
+			return true;
+		}
+	};
+
 	// Javascript-like logger for C++
 	class console
 	{
@@ -30,83 +123,163 @@ namespace cs_std
 			error	= 0b00010000,
 			fatal	= 0b00100000,
 		};
+		// What an asynchronous log call does when its thread's buffer is full
+		enum class overflow_policy : uint8_t
+		{
+			// Wait for the writer thread to make room
+			block,
+			// Discard the message
+			drop,
+			// Discard the message, the writer reports how many were lost
+			count,
+		};
 	private:
-		static constexpr const char* const SEVERITY_STRINGS[6] { "Verbose", "Info", "Log", "Warn", "Error", "Critical" };
-		static bool enableThreadSafety;
+		static constexpr const char* const (&SEVERITY_STRINGS)[6] = LOG_SEVERITY_STRINGS;
+		// Severities at or above CS_CONSOLE_MIN_SEVERITY
+		static constexpr severity COMPILED_SEVERITIES = static_cast<severity>(0b00111111 & ~((1 << CS_CONSOLE_MIN_SEVERITY) - 1));
+		// Read on every call without the lock, so kept atomic and accessed relaxed
+		static std::atomic<bool> enableThreadSafety;
 		static std::mutex threadMutex;
-		static severity displayedSeverities;
-		static bool printSeverity, printTimestamp;
-		static std::chrono::time_point<std::chrono::steady_clock> timePoint;
+		static std::atomic<severity> displayedSeverities;
+		static std::atomic<bool> printSeverity, printTimestamp, printElapsed;
+		// Per thread so begin and end on different threads do not disturb each other
+		static thread_local std::chrono::high_resolution_clock::time_point timePoint;
+		static std::atomic<bool> asyncEnabled;
+		// Default rate limit of CS_ macro call sites, zero interval when off
+		static std::atomic<uint64_t> limitInterval, limitBurst;
+		static std::atomic<log_site*> limitedSites;
 
+		// Room for a record of size bytes, in the calling thread's buffer in async mode, null if the message is dropped
+		static std::byte* reserve_record(size_t size);
+		// Hands the record from the last reserve_record to the writer thread, or writes it to the sinks
+		static void commit_record();
+		// Body of the writer thread, formats records from every thread's buffer
+		static void run_writer();
+		// Drains every thread's buffer from the calling thread unless another thread already is, used with thread safety off
+		static void merge_logs();
+		// Adds the site to the ones flush() reports on
+		static void list_site(log_site& site);
+		// Logs how many messages the site suppressed since it last did, at the site's severity
+		static void report_suppressed(log_site& site);
+		static uint8_t record_flags()
+		{
+			return (printTimestamp.load(std::memory_order_relaxed) ? log_record_flags::timestamp : 0) |
+				(printSeverity.load(std::memory_order_relaxed) ? log_record_flags::severity : 0) |
+				(printElapsed.load(std::memory_order_relaxed) ? log_record_flags::elapsed : 0);
+		}
+		// Encodes the arguments as a record, formatting is left to the sinks and only done once for all of them
 		template<typename... Ts>
-		static void base_log(severity_bits severity, Ts&&... args)
+		static void encode_log(uint8_t severity, const Ts&... args)
 		{
-			if (enableThreadSafety)
-			{
-				std::scoped_lock lock(threadMutex);
-				internal_log(severity, std::forward<Ts>(args)...);
-			}
-			else internal_log(severity, std::forward<Ts>(args)...);
+			auto values = internal::log_encodables(args...);
+			std::byte* data = reserve_record(internal::log_record_size(values));
+			if (data == nullptr) return;
+			internal::log_write_record(data, log_record_header{ internal::log_now(), log_signatures::id<Ts...>(), severity, record_flags(), 0 }, values);
+			commit_record();
 		}
 
 		template<typename... Ts>
-		static void internal_log(severity_bits severity, Ts&&... args)
+		static void base_log(severity_bits severity, Ts&&... args)
 		{
-			if ((displayedSeverities & static_cast<uint8_t>(severity)) == 0) return;
-			if (printTimestamp)
-			{
-				int64_t time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-				std::cout << '[' << std::put_time(std::localtime(&time), "%T") << "] ";
-			}
-			if (printSeverity) std::cout << '[' << SEVERITY_STRINGS[static_cast<size_t>(std::log2(static_cast<double>(severity)))] << "] ";
-			([&] {
-				if constexpr (std::is_same_v<std::decay_t<Ts>, bool>) std::cout << (args ? "true" : "false");
-				else std::cout << args;
-			} (), ...);
-			std::cout << "\n";
+			if (enabled(severity)) encode_log(static_cast<uint8_t>(severity), args...);
 		}
-		template<typename... Ts> static void raw_base(Ts&&... args) { ([&] { std::cout << args; } (), ...); }
 	public:
 		// Verbose, usually not displayed
 		template <typename... Ts>
-		static void verbose(Ts&&... args) { base_log(severity_bits::verbose, args...); }
+		static void verbose(Ts&&... args) { if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::verbose)) != 0) base_log(severity_bits::verbose, args...); }
 		// Info, provides useful information alongside other logs
 		template <typename... Ts>
-		static void info(Ts&&... args) { base_log(severity_bits::info, args...); }
+		static void info(Ts&&... args) { if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::info)) != 0) base_log(severity_bits::info, args...); }
 		// Log, standard logging method
 		template <typename... Ts>
-		static void log(Ts&&... args) { base_log(severity_bits::log, args...); }
+		static void log(Ts&&... args) { if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::log)) != 0) base_log(severity_bits::log, args...); }
 		// Warn, denotes potential side-effects or errors
 		template <typename... Ts>
-		static void warn(Ts&&... args) { base_log(severity_bits::warn, args...); }
+		static void warn(Ts&&... args) { if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::warn)) != 0) base_log(severity_bits::warn, args...); }
 		// Error, denotes a non-fatal error
 		template <typename... Ts>
-		static void error(Ts&&... args) { base_log(severity_bits::error, args...); }
+		static void error(Ts&&... args) { if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::error)) != 0) base_log(severity_bits::error, args...); }
 		// Fatal, denotes a fatal error that requires a program crash
+		// Everything logged so far is written out and flushed before this returns
 		template <typename... Ts>
-		static void fatal(Ts&&... args) { base_log(severity_bits::fatal, args...); }
-
-		template<typename... Ts>
-		static void raw(Ts&&... args)
+		static void fatal(Ts&&... args)
 		{
-			if (enableThreadSafety)
-			{
-				std::scoped_lock lock(threadMutex);
-				raw_base(std::forward<Ts>(args)...);
-			}
-			else raw_base(std::forward<Ts>(args)...);
+			if constexpr ((COMPILED_SEVERITIES & static_cast<uint8_t>(severity_bits::fatal)) == 0) return;
+			base_log(severity_bits::fatal, args...);
+			flush();
 		}
 
+		template<typename... Ts>
+		static void raw(Ts&&... args) { encode_log(0, args...); }
+
 		// Set the severity flags, by default allows info, log, warn, error and fatal
-		static void severity_flags(severity severityFlag) { displayedSeverities = severityFlag; }
-		// Enables thread safety, on by default, can improve performance slightly if turned off
-		// However, if turned off does not gaurantee order or correctness
-		static void thread_safety(bool enable) { enableThreadSafety = enable; }
+		static void severity_flags(severity severityFlag) { displayedSeverities.store(severityFlag, std::memory_order_relaxed); }
+		// Whether a severity is compiled in and currently displayed
+		static constexpr bool compiled_in(severity_bits severity) { return (COMPILED_SEVERITIES & static_cast<uint8_t>(severity)) != 0; }
+		static bool enabled(severity_bits severity) { return compiled_in(severity) && (displayedSeverities.load(std::memory_order_relaxed) & static_cast<uint8_t>(severity)) != 0; }
+		// Enables thread safety, on by default, every log call then writes out under one global lock
+		// Turned off, log calls encode into a per thread lock-free buffer instead, and whichever thread finds no other one
+		// already doing so drains every buffer, oldest message first, the rest return straight away
+		// Lines are always written whole, and a message made after another one was logged, on any thread, is written after it
+		// An uncontended call drains under the same lock as thread safety on and also encodes into the buffer, so it costs more
+		// The gain is that callers under contention return instead of queueing on the lock, tools/console_benchmark.cpp measures both
+		static void thread_safety(bool enable) { enableThreadSafety.store(enable, std::memory_order_relaxed); }
 		// Whether or not to print the HH:MM::SS timestamps next to the logs
-		static void print_timestamps(bool enable) { printTimestamp = enable; }
+		static void print_timestamps(bool enable) { printTimestamp.store(enable, std::memory_order_relaxed); }
 		// Whether or not to print the severity of the log	
-		static void print_severity(bool enable) { printSeverity = enable; }
+		static void print_severity(bool enable) { printSeverity.store(enable, std::memory_order_relaxed); }
+		// Whether or not to print the time since logging started, as [+seconds.microseconds], taken from the steady clock
+		static void print_elapsed(bool enable) { printElapsed.store(enable, std::memory_order_relaxed); }
+		// Async mode, log calls only encode their arguments into a per thread lock-free buffer
+		// A background writer thread formats and writes them in batches, so output lags slightly behind the calls
+		// Messages are written oldest first across threads, ordered by their timestamps
+		// threadBufferBytes sizes buffers created after the call, messages larger than half a buffer are passed on the heap
+		static void async(bool enable, overflow_policy policy = overflow_policy::block, size_t threadBufferBytes = size_t(1) << 20);
+		static bool is_async() { return asyncEnabled.load(std::memory_order_relaxed); }
+		// Blocks until every message logged before the call has been written and the output flushed, call before exiting or crashing
+		static void flush();
+		// Messages discarded by the drop and count overflow policies
+		static uint64_t dropped_messages();
+		// Every message goes to each attached sink whose severity mask accepts it, stdout is attached to begin with
+		// Attaching and detaching never blocks log calls, a detached sink gets everything logged before detach was called
+		// In async mode a message goes to the sinks attached when the writer thread gets to it
+		static void attach(std::shared_ptr<log_sink> sink);
+		static void detach(const std::shared_ptr<log_sink>& sink);
+		// The stdout sink the console starts with, detach it to silence stdout
+		static const std::shared_ptr<log_sink>& standard_output();
+		// Limits every CS_ macro call site to perSecond messages, with bursts of up to burst, zero turns limiting off, the default
+		// Calls over the limit only count themselves, the site's next message that gets through first logs how many it dropped
+		// flush() reports on every site with suppressed messages, CS_RATE_LIMITED gives a site its own limit, fatal sites are exempt
+		static void rate_limit(double perSecond, uint32_t burst = 1);
+		// Whether a CS_ macro call site may log now, takes a token from its bucket
+		static bool admit(log_site& site)
+		{
+			uint64_t interval = site.interval, burst = site.burst;
+			if (interval == 0)
+			{
+				// Fatal messages are not held back by the default limit
+				if (site.severity == static_cast<uint8_t>(severity_bits::fatal)) return true;
+				interval = limitInterval.load(std::memory_order_relaxed);
+				if (interval == 0) return true;
+				burst = limitBurst.load(std::memory_order_relaxed);
+			}
+			if (!site.take(internal::log_now(), interval, burst))
+			{
+				site.suppressed.fetch_add(1, std::memory_order_relaxed);
+				if (!site.listed.load(std::memory_order_relaxed)) list_site(site);
+				return false;
+			}
+			if (site.suppressed.load(std::memory_order_relaxed) != 0) report_suppressed(site);
+			return true;
+		}
+		// Shorthand for attaching a binary_file_sink in place of stdout, truncating the file
+		// Only the arguments' bytes are stored, each distinct list of argument types is described once in the file
+		// tools/log_decoder.cpp turns the file back into text or JSON, returns false if the file cannot be opened
+		static bool open_binary_log(const std::filesystem::path& filePath);
+		// Detaches the binary log and puts stdout back if open_binary_log took it off
+		static void close_binary_log();
 
+		// Stopwatch for the calling thread, end() gives the time since its last begin(), use CS_PROFILE_SCOPE for nested timings
 		static void begin() { timePoint = std::chrono::high_resolution_clock::now(); }
 		template<typename TimeUnit = std::chrono::seconds> static size_t end() { return std::chrono::duration_cast<TimeUnit>(std::chrono::high_resolution_clock::now() - timePoint).count(); }
 	};
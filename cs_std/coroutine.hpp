@@ -0,0 +1,269 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <coroutine>
+#include <type_traits>
+#include "task_queue.hpp"
+#include "object_pool.hpp"
+
+namespace cs_std
+{
+	template<typename T = void> class co_task;
+
+	namespace internal
+	{
+		// Coroutine frames are rounded up to a size class and cached in a block_pool, larger frames go to the heap
+		inline void* allocate_frame(size_t size)
+		{
+			if (size <= 128) return block_pool<128>::allocate();
+			if (size <= 256) return block_pool<256>::allocate();
+			if (size <= 512) return block_pool<512>::allocate();
+			if (size <= 1024) return block_pool<1024>::allocate();
+			if (size <= 2048) return block_pool<2048>::allocate();
+			return ::operator new(size);
+		}
+		inline void deallocate_frame(void* frame, size_t size)
+		{
+			if (size <= 128) block_pool<128>::deallocate(frame);
+			else if (size <= 256) block_pool<256>::deallocate(frame);
+			else if (size <= 512) block_pool<512>::deallocate(frame);
+			else if (size <= 1024) block_pool<1024>::deallocate(frame);
+			else if (size <= 2048) block_pool<2048>::deallocate(frame);
+			else ::operator delete(frame, size);
+		}
+		struct pooled_frame
+		{
+			static void* operator new(size_t size) { return allocate_frame(size); }
+			static void operator delete(void* frame, size_t size) { deallocate_frame(frame, size); }
+		};
+
+		struct co_promise_base : pooled_frame
+		{
+			std::coroutine_handle<> continuation;
+			std::exception_ptr exception;
+
+			// Hands control straight back to whoever awaited the task, without growing the stack
+			struct final_awaiter
+			{
+				bool await_ready() const noexcept { return false; }
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				void await_resume() const noexcept {}
+			};
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			final_awaiter final_suspend() const noexcept { return {}; }
+			void unhandled_exception() { this->exception = std::current_exception(); }
+		};
+		template<typename T>
+		struct co_promise : co_promise_base
+		{
+			std::optional<T> value;
+
+			co_task<T> get_return_object();
+			template<typename U>
+			void return_value(U&& result) { this->value.emplace(std::forward<U>(result)); }
+			T take()
+			{
+				if (this->exception) std::rethrow_exception(this->exception);
+				return std::move(this->value.value());
+			}
+		};
+		template<>
+		struct co_promise<void> : co_promise_base
+		{
+			co_task<void> get_return_object();
+			void return_void() {}
+			void take()
+			{
+				if (this->exception) std::rethrow_exception(this->exception);
+			}
+		};
+
+		// Fire and forget coroutine, starts immediately and frees its own frame when it finishes
+		struct co_detached
+		{
+			struct promise_type : pooled_frame
+			{
+				co_detached get_return_object() { return {}; }
+				std::suspend_never initial_suspend() const noexcept { return {}; }
+				std::suspend_never final_suspend() const noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { std::terminate(); }
+			};
+		};
+	}
+
+	/// <summary>
+	/// Lazily started coroutine producing a T
+	/// The body does not run until the task is awaited, spawned or passed to sync_wait
+	/// Frames are allocated from thread local block pools
+	/// </summary>
+	template<typename T>
+	class co_task
+	{
+	public:
+		using promise_type = internal::co_promise<T>;
+	private:
+		std::coroutine_handle<promise_type> handle;
+
+		template<typename U> friend struct internal::co_promise;
+		explicit co_task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	public:
+		co_task() : handle(nullptr) {}
+		~co_task() { if (this->handle) this->handle.destroy(); }
+		co_task(const co_task<T>&) = delete;
+		co_task<T>& operator=(const co_task<T>&) = delete;
+		co_task(co_task<T>&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		co_task<T>& operator=(co_task<T>&& other) noexcept
+		{
+			if (this == &other) return *this;
+			if (this->handle) this->handle.destroy();
+			this->handle = std::exchange(other.handle, nullptr);
+			return *this;
+		}
+		bool valid() const { return static_cast<bool>(this->handle); }
+		bool done() const { return this->handle && this->handle.done(); }
+		// Result of a finished task, rethrows if the body threw
+		T result() { return this->handle.promise().take(); }
+
+		auto operator co_await() noexcept
+		{
+			struct awaiter
+			{
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() const noexcept { return !this->handle || this->handle.done(); }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+				{
+					this->handle.promise().continuation = awaiting;
+					return this->handle;
+				}
+				T await_resume() { return this->handle.promise().take(); }
+			};
+			return awaiter{ this->handle };
+		}
+	};
+
+	template<typename T>
+	co_task<T> internal::co_promise<T>::get_return_object() { return co_task<T>(std::coroutine_handle<co_promise<T>>::from_promise(*this)); }
+	inline co_task<void> internal::co_promise<void>::get_return_object() { return co_task<void>(std::coroutine_handle<co_promise<void>>::from_promise(*this)); }
+
+	namespace internal
+	{
+		template<typename T>
+		co_detached run_into(co_task<T> task, task_queue* queue, task_state<T>* state)
+		{
+			if (queue != nullptr) co_await queue->schedule();
+			try
+			{
+				if constexpr (std::is_void_v<T>)
+				{
+					co_await task;
+					state->value.emplace();
+				}
+				else state->value.emplace(co_await task);
+			}
+			catch (...)
+			{
+				state->exception = std::current_exception();
+			}
+			state->complete();
+			state->release();
+		}
+
+		struct co_latch
+		{
+			std::atomic<size_t> remaining;
+			std::coroutine_handle<> waiter;
+
+			void arrive() { if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) this->waiter.resume(); }
+		};
+		template<typename T>
+		co_detached arrive_when_done(co_task<T>& task, co_latch& latch)
+		{
+			// Results and exceptions stay in the task, they are collected once every task has finished
+			try
+			{
+				co_await task;
+			}
+			catch (...) {}
+			latch.arrive();
+		}
+		// Starts every task on the awaiting thread and resumes the awaiting coroutine on whichever thread finishes the last one
+		template<typename T>
+		struct when_all_awaitable
+		{
+			std::vector<co_task<T>>& tasks;
+			co_latch latch;
+
+			explicit when_all_awaitable(std::vector<co_task<T>>& tasks) : tasks(tasks), latch{ tasks.size() + 1, nullptr } {}
+			bool await_ready() const noexcept { return this->tasks.empty(); }
+			bool await_suspend(std::coroutine_handle<> awaiting)
+			{
+				this->latch.waiter = awaiting;
+				for (co_task<T>& task : this->tasks) arrive_when_done(task, this->latch);
+				// Do not suspend at all if every task already finished synchronously
+				return this->latch.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+			}
+			void await_resume() const noexcept {}
+		};
+	}
+
+	// Starts the coroutine on one of the queue's threads, the returned handle completes with its result
+	template<typename T>
+	task_handle<T> spawn(task_queue& queue, co_task<T> task)
+	{
+		internal::task_state<T>* state = internal::task_state<T>::create(&queue, 2);
+		internal::run_into(std::move(task), &queue, state);
+		return task_handle<T>(state);
+	}
+	// Runs the coroutine starting on the calling thread and blocks until it finishes
+	template<typename T>
+	T sync_wait(co_task<T> task)
+	{
+		internal::task_state<T>* state = internal::task_state<T>::create(nullptr, 2);
+		internal::run_into(std::move(task), nullptr, state);
+		task_handle<T> handle(state);
+		if constexpr (std::is_void_v<T>) handle.get();
+		else return handle.get();
+	}
+
+	// Awaitable that completes once every task has finished, results are returned in the order of tasks
+	// Every task is run to completion even if one of them throws, the first exception in task order is rethrown
+	template<typename T>
+	co_task<std::vector<T>> when_all(std::vector<co_task<T>> tasks)
+	{
+		co_await internal::when_all_awaitable<T>(tasks);
+		std::vector<T> results;
+		results.reserve(tasks.size());
+		for (co_task<T>& task : tasks) results.push_back(task.result());
+		co_return results;
+	}
+	inline co_task<void> when_all(std::vector<co_task<void>> tasks)
+	{
+		co_await internal::when_all_awaitable<void>(tasks);
+		for (co_task<void>& task : tasks) task.result();
+	}
+
+	// Lets coroutines await a task_handle, the coroutine resumes on the handle's queue once the result is ready
+	template<typename T>
+	auto operator co_await(const task_handle<T>& handle)
+	{
+		struct awaiter
+		{
+			task_handle<T> handle;
+
+			bool await_ready() const { return this->handle.ready(); }
+			void await_suspend(std::coroutine_handle<> awaiting) { this->handle.shared_state()->add_continuation([awaiting]() { awaiting.resume(); }, false); }
+			decltype(auto) await_resume() const { return this->handle.get(); }
+		};
+		return awaiter{ handle };
+	}
+}
\ No newline at end of file
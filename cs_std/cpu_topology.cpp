@@ -0,0 +1,130 @@
+#include "cpu_topology.hpp"
+#include <thread>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace cs_std
+{
+	namespace
+	{
+		// Parses the sysfs cpulist format, e.g. "0-3,8-11"
+		std::vector<size_t> parse_cpu_list(const std::string& list)
+		{
+			std::vector<size_t> cpus;
+			size_t position = 0;
+			while (position < list.size())
+			{
+				size_t end = list.find(',', position);
+				if (end == std::string::npos) end = list.size();
+				std::string range = list.substr(position, end - position);
+				position = end + 1;
+				if (range.empty() || range.find_first_not_of(" \n") == std::string::npos) continue;
+
+				size_t dash = range.find('-');
+				size_t first = std::stoul(range.substr(0, dash));
+				size_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+				for (size_t cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+			}
+			return cpus;
+		}
+		std::vector<size_t> allowed_cpus()
+		{
+			std::vector<size_t> cpus;
+#if defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if (sched_getaffinity(0, sizeof(set), &set) == 0)
+			{
+				for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+			}
+#endif
+			if (cpus.empty())
+			{
+				for (size_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) cpus.push_back(cpu);
+			}
+			return cpus;
+		}
+	}
+
+	cpu_topology cpu_topology::detect()
+	{
+		cpu_topology topology;
+		std::vector<size_t> allowed = allowed_cpus();
+#if defined(__linux__)
+		std::error_code error;
+		const std::filesystem::path root = "/sys/devices/system/node";
+		for (const auto& entry : std::filesystem::directory_iterator(root, error))
+		{
+			std::string name = entry.path().filename().string();
+			if (name.rfind("node", 0) != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos) continue;
+
+			std::ifstream file(entry.path() / "cpulist");
+			std::string list;
+			if (!std::getline(file, list)) continue;
+
+			numa_node node{ std::stoul(name.substr(4)), {} };
+			for (size_t cpu : parse_cpu_list(list))
+			{
+				if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) node.cpus.push_back(cpu);
+			}
+			// Memory only nodes and nodes outside our affinity mask are of no use for placing threads
+			if (!node.cpus.empty()) topology.nodes.push_back(std::move(node));
+		}
+		std::sort(topology.nodes.begin(), topology.nodes.end(), [](const numa_node& a, const numa_node& b) { return a.id < b.id; });
+#endif
+		if (topology.nodes.empty()) topology.nodes.push_back(numa_node{ 0, allowed });
+		return topology;
+	}
+	size_t cpu_topology::cpu_count() const
+	{
+		size_t count = 0;
+		for (const numa_node& node : this->nodes) count += node.cpus.size();
+		return count;
+	}
+	std::vector<size_t> cpu_topology::interleaved_cpus() const
+	{
+		std::vector<size_t> cpus;
+		cpus.reserve(this->cpu_count());
+		for (size_t i = 0; cpus.size() < this->cpu_count(); i++)
+		{
+			for (const numa_node& node : this->nodes) if (i < node.cpus.size()) cpus.push_back(node.cpus[i]);
+		}
+		return cpus;
+	}
+	size_t cpu_topology::node_of(size_t cpu) const
+	{
+		for (size_t i = 0; i < this->nodes.size(); i++)
+		{
+			if (std::find(this->nodes[i].cpus.begin(), this->nodes[i].cpus.end(), cpu) != this->nodes[i].cpus.end()) return i;
+		}
+		return 0;
+	}
+
+	bool set_current_thread_affinity(const std::vector<size_t>& cpus)
+	{
+		if (cpus.empty()) return false;
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (size_t cpu : cpus) if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (size_t cpu : cpus) if (cpu < sizeof(DWORD_PTR) * 8) mask |= DWORD_PTR(1) << cpu;
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+		return false;
+#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace cs_std
+{
+	struct numa_node
+	{
+		size_t id;
+		// Logical CPUs in this node that the process is allowed to run on
+		std::vector<size_t> cpus;
+	};
+
+	/// <summary>
+	/// Logical CPU layout of the machine grouped by NUMA node
+	/// On Linux this is read from sysfs, elsewhere it falls back to a single node containing every CPU
+	/// </summary>
+	class cpu_topology
+	{
+	public:
+		std::vector<numa_node> nodes;
+
+		static cpu_topology detect();
+		size_t cpu_count() const;
+		// Interleaves the CPUs of every node so that taking the first n spreads work evenly across nodes
+		std::vector<size_t> interleaved_cpus() const;
+		// Index into nodes of the node containing cpu, 0 if it is not found
+		size_t node_of(size_t cpu) const;
+	};
+
+	// Restricts the calling thread to the given logical CPUs, returns false if unsupported or the call failed
+	bool set_current_thread_affinity(const std::vector<size_t>& cpus);
+}
\ No newline at end of file
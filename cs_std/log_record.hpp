@@ -0,0 +1,414 @@
+#pragma once
+#include <bit>
+#include <mutex>
+#include <chrono>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <charconv>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace cs_std
+{
+	// How one logged argument is stored in an encoded record
+	enum class log_arg_type : uint8_t
+	{
+		boolean,
+		character,
+		int16,
+		int32,
+		int64,
+		uint16,
+		uint32,
+		uint64,
+		float32,
+		float64,
+		pointer,
+		// u32 length followed by the bytes, also used for types only printable through operator<<, which are formatted by the caller
+		string,
+	};
+
+	// Names of the console severities, indexed by the position of the severity bit
+	inline constexpr const char* const LOG_SEVERITY_STRINGS[6] { "Verbose", "Info", "Log", "Warn", "Error", "Critical" };
+
+	namespace log_record_flags
+	{
+		constexpr uint8_t timestamp = 0b001;
+		constexpr uint8_t severity	= 0b010;
+		// Time since the log origin, see internal::log_origin
+		constexpr uint8_t elapsed	= 0b100;
+	}
+
+	// Fixed part of every encoded log record, the encoded arguments follow it in order
+	struct log_record_header
+	{
+		// Nanoseconds since the Unix epoch
+		uint64_t time;
+		// Index into log_signatures
+		uint32_t signature;
+		// A console::severity_bits value, 0 for raw output
+		uint8_t severity;
+		// log_record_flags in effect when the record was made
+		uint8_t flags;
+		uint16_t reserved;
+	};
+
+	namespace internal
+	{
+		template<typename T>
+		constexpr log_arg_type log_arg_type_of()
+		{
+			using U = std::remove_cvref_t<T>;
+			if constexpr (std::is_same_v<U, bool>) return log_arg_type::boolean;
+			// ostream prints every char flavour as a character
+			else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char> || std::is_same_v<U, unsigned char>) return log_arg_type::character;
+			else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) return sizeof(U) <= 2 ? log_arg_type::int16 : sizeof(U) == 4 ? log_arg_type::int32 : log_arg_type::int64;
+			else if constexpr (std::is_integral_v<U>) return sizeof(U) <= 2 ? log_arg_type::uint16 : sizeof(U) == 4 ? log_arg_type::uint32 : log_arg_type::uint64;
+			else if constexpr (std::is_same_v<U, float>) return log_arg_type::float32;
+			else if constexpr (std::is_floating_point_v<U>) return log_arg_type::float64;
+			else if constexpr (std::is_null_pointer_v<U>) return log_arg_type::pointer;
+			else if constexpr (std::is_convertible_v<const U&, std::string_view>) return log_arg_type::string;
+			else if constexpr (std::is_pointer_v<U>) return log_arg_type::pointer;
+			else return log_arg_type::string;
+		}
+
+		// The value actually written for an argument, strings are viewed and anything else printable is formatted here
+		template<typename T>
+		auto log_encodable(const T& value)
+		{
+			using U = std::remove_cvref_t<T>;
+			constexpr log_arg_type type = log_arg_type_of<T>();
+			if constexpr (type == log_arg_type::boolean) return static_cast<uint8_t>(value);
+			else if constexpr (type == log_arg_type::character) return static_cast<char>(value);
+			else if constexpr (type == log_arg_type::int16) return static_cast<int16_t>(value);
+			else if constexpr (type == log_arg_type::int32) return static_cast<int32_t>(value);
+			else if constexpr (type == log_arg_type::int64) return static_cast<int64_t>(value);
+			else if constexpr (type == log_arg_type::uint16) return static_cast<uint16_t>(value);
+			else if constexpr (type == log_arg_type::uint32) return static_cast<uint32_t>(value);
+			else if constexpr (type == log_arg_type::uint64) return static_cast<uint64_t>(value);
+			else if constexpr (type == log_arg_type::float32) return static_cast<float>(value);
+			else if constexpr (type == log_arg_type::float64) return static_cast<double>(value);
+			else if constexpr (std::is_null_pointer_v<U>) return uint64_t(0);
+			else if constexpr (type == log_arg_type::pointer) return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+			else if constexpr (std::is_convertible_v<const U&, std::string_view>) return std::string_view(value);
+			else
+			{
+				std::ostringstream stream;
+				stream << value;
+				return std::move(stream).str();
+			}
+		}
+		template<typename T>
+		size_t log_encoded_size(const T& value)
+		{
+			if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) return sizeof(uint32_t) + value.size();
+			else return sizeof(T);
+		}
+		template<typename T>
+		void log_encode(std::byte*& out, const T& value)
+		{
+			if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>)
+			{
+				uint32_t length = static_cast<uint32_t>(value.size());
+				std::memcpy(out, &length, sizeof(length));
+				std::memcpy(out + sizeof(length), value.data(), length);
+				out += sizeof(length) + length;
+			}
+			else
+			{
+				std::memcpy(out, &value, sizeof(T));
+				out += sizeof(T);
+			}
+		}
+
+		// Values for every argument, then the size and contents of the whole record
+		template<typename... Ts>
+		auto log_encodables(const Ts&... args) { return std::make_tuple(log_encodable(args)...); }
+		template<typename Tuple>
+		size_t log_record_size(const Tuple& values) { return std::apply([](const auto&... value) { return (sizeof(log_record_header) + ... + log_encoded_size(value)); }, values); }
+		template<typename Tuple>
+		void log_write_record(std::byte* out, const log_record_header& header, const Tuple& values)
+		{
+			std::memcpy(out, &header, sizeof(header));
+			out += sizeof(header);
+			std::apply([&](const auto&... value) { (log_encode(out, value), ...); }, values);
+		}
+		// Wall clock and steady clock readings taken together the first time anything is logged
+		struct log_clock_origin
+		{
+			uint64_t wall;
+			std::chrono::steady_clock::time_point steady;
+		};
+		inline const log_clock_origin& log_origin()
+		{
+			static const log_clock_origin origin{ static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()), std::chrono::steady_clock::now() };
+			return origin;
+		}
+		// Unix time in nanoseconds, advanced by the steady clock from the origin so record times never go backwards
+		// Wall clock adjustments made after the origin are not picked up
+		inline uint64_t log_now()
+		{
+			const log_clock_origin& origin = log_origin();
+			return origin.wall + static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin.steady).count());
+		}
+
+		template<typename T>
+		T log_read(const std::byte*& data)
+		{
+			T value;
+			std::memcpy(&value, data, sizeof(T));
+			data += sizeof(T);
+			return value;
+		}
+		template<typename T>
+		void log_append_number(std::string& out, T value)
+		{
+			char digits[32];
+			std::to_chars_result result;
+			// Six significant digits, the same as ostream's default
+			if constexpr (std::is_floating_point_v<T>) result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+			else result = std::to_chars(digits, digits + sizeof(digits), value);
+			out.append(digits, result.ptr);
+		}
+		// Appends the text of one encoded argument the way operator<< would print it, returns the next argument
+		inline const std::byte* log_append_argument(std::string& out, log_arg_type type, const std::byte* data, bool boolAlpha = true)
+		{
+			switch (type)
+			{
+			case log_arg_type::boolean:
+				if (boolAlpha) out += log_read<uint8_t>(data) != 0 ? "true" : "false";
+				else out += log_read<uint8_t>(data) != 0 ? '1' : '0';
+				break;
+			case log_arg_type::character: out += log_read<char>(data); break;
+			case log_arg_type::int16: log_append_number(out, log_read<int16_t>(data)); break;
+			case log_arg_type::int32: log_append_number(out, log_read<int32_t>(data)); break;
+			case log_arg_type::int64: log_append_number(out, log_read<int64_t>(data)); break;
+			case log_arg_type::uint16: log_append_number(out, log_read<uint16_t>(data)); break;
+			case log_arg_type::uint32: log_append_number(out, log_read<uint32_t>(data)); break;
+			case log_arg_type::uint64: log_append_number(out, log_read<uint64_t>(data)); break;
+			case log_arg_type::float32: log_append_number(out, log_read<float>(data)); break;
+			case log_arg_type::float64: log_append_number(out, log_read<double>(data)); break;
+			case log_arg_type::pointer:
+			{
+				uint64_t address = log_read<uint64_t>(data);
+				if (address == 0)
+				{
+					out += '0';
+					break;
+				}
+				char digits[16];
+				out += "0x";
+				out.append(digits, std::to_chars(digits, digits + sizeof(digits), address, 16).ptr);
+				break;
+			}
+			case log_arg_type::string:
+			{
+				uint32_t length = log_read<uint32_t>(data);
+				out.append(reinterpret_cast<const char*>(data), length);
+				data += length;
+				break;
+			}
+			}
+			return data;
+		}
+		// Local time of a Unix time in nanoseconds as "[HH:MM:SS] "
+		// Each thread caches the text of the last second it formatted, so localtime runs about once a second per thread
+		inline std::string_view log_time_prefix(uint64_t nanoseconds)
+		{
+			struct prefix_cache
+			{
+				uint64_t second = UINT64_MAX;
+				char text[16];
+				size_t length = 0;
+			};
+			thread_local prefix_cache cache;
+			uint64_t second = nanoseconds / 1'000'000'000;
+			if (second != cache.second)
+			{
+				std::time_t seconds = static_cast<std::time_t>(second);
+				std::tm local;
+#if defined(_WIN32)
+				localtime_s(&local, &seconds);
+#else
+				localtime_r(&seconds, &local);
+#endif
+				cache.length = std::strftime(cache.text, sizeof(cache.text), "[%T] ", &local);
+				cache.second = second;
+			}
+			return { cache.text, cache.length };
+		}
+		// Nanoseconds since origin as "[+seconds.microseconds] ", buffer must hold 32 characters
+		inline std::string_view log_elapsed_text(char* buffer, uint64_t nanoseconds, uint64_t origin)
+		{
+			uint64_t elapsed = nanoseconds > origin ? (nanoseconds - origin) / 1000 : 0;
+			char* end = buffer;
+			*end++ = '[';
+			*end++ = '+';
+			end = std::to_chars(end, buffer + 20, elapsed / 1'000'000).ptr;
+			*end++ = '.';
+			for (uint64_t digit = 100'000, micros = elapsed % 1'000'000; digit != 0; digit /= 10) *end++ = static_cast<char>('0' + micros / digit % 10);
+			*end++ = ']';
+			*end++ = ' ';
+			return { buffer, static_cast<size_t>(end - buffer) };
+		}
+		// A record as the console prints it, raw records have no prefix or line break
+		// origin is the Unix time elapsed times count from, the decoder passes the one stored in the file
+		inline void log_append_text(std::string& out, const log_record_header& header, const std::vector<log_arg_type>& signature, const std::byte* data, uint64_t origin = log_origin().wall)
+		{
+			if (header.severity != 0)
+			{
+				if (header.flags & log_record_flags::timestamp) out += log_time_prefix(header.time);
+				if (header.flags & log_record_flags::elapsed)
+				{
+					char buffer[32];
+					out += log_elapsed_text(buffer, header.time, origin);
+				}
+				if (header.flags & log_record_flags::severity)
+				{
+					out += '[';
+					out += LOG_SEVERITY_STRINGS[std::countr_zero(header.severity)];
+					out += "] ";
+				}
+			}
+			// Raw output prints bools the way operator<< does
+			for (log_arg_type type : signature) data = log_append_argument(out, type, data, header.severity != 0);
+			if (header.severity != 0) out += '\n';
+		}
+		inline void log_append_json_string(std::string& out, std::string_view text)
+		{
+			out += '"';
+			for (char character : text)
+			{
+				switch (character)
+				{
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(character) < 0x20)
+					{
+						out += "\\u00";
+						out += "0123456789abcdef"[character >> 4];
+						out += "0123456789abcdef"[character & 0xF];
+					}
+					else out += character;
+				}
+			}
+			out += '"';
+		}
+		// A record as one line of JSON: {"time":ns,"severity":"Info","message":"...","args":[...]}
+		inline void log_append_json(std::string& out, const log_record_header& header, const std::vector<log_arg_type>& signature, const std::byte* data)
+		{
+			out += "{\"time\":";
+			log_append_number(out, header.time);
+			out += ",\"severity\":";
+			if (header.severity != 0) log_append_json_string(out, LOG_SEVERITY_STRINGS[std::countr_zero(header.severity)]);
+			else out += "null";
+			std::string message, argument;
+			out += ",\"args\":[";
+			for (size_t i = 0; i < signature.size(); i++)
+			{
+				argument.clear();
+				const std::byte* value = data;
+				data = log_append_argument(argument, signature[i], data, true);
+				message += argument;
+				if (i != 0) out += ',';
+				switch (signature[i])
+				{
+				case log_arg_type::character:
+				case log_arg_type::pointer:
+				case log_arg_type::string:
+					log_append_json_string(out, argument);
+					break;
+				case log_arg_type::float32:
+				case log_arg_type::float64:
+				{
+					// JSON has no infinities or NaN
+					double number = signature[i] == log_arg_type::float32 ? log_read<float>(value) : log_read<double>(value);
+					if (number == number && number - number == 0) out += argument;
+					else log_append_json_string(out, argument);
+					break;
+				}
+				default: out += argument;
+				}
+			}
+			out += "],\"message\":";
+			log_append_json_string(out, message);
+			out += "}\n";
+		}
+	}
+
+	// Layout of the binary log written by console::open_binary_log, in native byte order:
+	// the 8 byte magic "CSLOG001", then chunks each starting with a u8 log_chunk value
+	// origin chunk: u64 Unix time in nanoseconds that elapsed times count from, written first
+	// signature chunk: u32 id, u16 argument count, one u8 log_arg_type per argument, written before the first record using it
+	// record chunk: u32 size, then size bytes of log_record_header followed by the encoded arguments
+	inline constexpr char LOG_FILE_MAGIC[8] { 'C', 'S', 'L', 'O', 'G', '0', '0', '1' };
+	enum class log_chunk : uint8_t
+	{
+		signature = 1,
+		record = 2,
+		origin = 3,
+	};
+
+	/// <summary>
+	/// Process wide table of argument type lists
+	/// Each distinct list is registered once, records then refer to it by index instead of describing their arguments
+	/// </summary>
+	class log_signatures
+	{
+	private:
+		struct signature_table
+		{
+			std::mutex mutex;
+			// Entries are never moved or freed, so references handed out stay valid
+			std::vector<std::unique_ptr<const std::vector<log_arg_type>>> entries;
+		};
+		// Leaked so that log calls made by static destructors at exit can still register and format their records
+		static signature_table& table()
+		{
+			static signature_table* instance = new signature_table();
+			return *instance;
+		}
+	public:
+		// Registered the first time each argument list is logged, a function local static after that
+		template<typename... Ts>
+		static uint32_t id()
+		{
+			static const uint32_t value = add({ internal::log_arg_type_of<Ts>()... });
+			return value;
+		}
+		// Returns the index of an equal list if there is one
+		static uint32_t add(std::vector<log_arg_type> arguments)
+		{
+			signature_table& signatures = table();
+			std::lock_guard<std::mutex> lock(signatures.mutex);
+			for (size_t i = 0; i < signatures.entries.size(); i++)
+			{
+				if (*signatures.entries[i] == arguments) return static_cast<uint32_t>(i);
+			}
+			signatures.entries.push_back(std::make_unique<const std::vector<log_arg_type>>(std::move(arguments)));
+			return static_cast<uint32_t>(signatures.entries.size() - 1);
+		}
+		static const std::vector<log_arg_type>& get(uint32_t id)
+		{
+			signature_table& signatures = table();
+			std::lock_guard<std::mutex> lock(signatures.mutex);
+			return *signatures.entries[id];
+		}
+		static uint32_t count()
+		{
+			signature_table& signatures = table();
+			std::lock_guard<std::mutex> lock(signatures.mutex);
+			return static_cast<uint32_t>(signatures.entries.size());
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+#include <span>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "cache_line.hpp"
+
+namespace cs_std
+{
+	/// <summary>
+	/// Wait-free single producer single consumer ring of variable length records
+	/// Records are written in place, reserve() hands out contiguous space and commit() publishes it
+	/// A record that would straddle the end of the buffer is preceded by padding and starts again at the front
+	/// </summary>
+	class log_ring
+	{
+	private:
+		// Every record starts with a header holding its payload size, records are kept 8 byte aligned
+		static constexpr size_t HEADER_SIZE = 8;
+		static constexpr uint32_t PADDING = std::numeric_limits<uint32_t>::max();
+
+		size_t capacity;
+		size_t mask;
+		std::unique_ptr<std::byte[]> buffer;
+		// Consumer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> head = 0;
+		size_t cachedTail = 0;
+		// Producer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail = 0;
+		size_t cachedHead = 0;
+		// Position the reserved record will be published up to
+		size_t pendingTail = 0;
+
+		static size_t align(size_t size) { return (size + 7) & ~size_t(7); }
+		static size_t round_to_power_of_two(size_t size)
+		{
+			size_t result = 64;
+			while (result < size) result <<= 1;
+			return result;
+		}
+		void write_header(size_t position, uint32_t size) { std::memcpy(this->buffer.get() + (position & this->mask), &size, sizeof(size)); }
+		uint32_t read_header(size_t position) const
+		{
+			uint32_t size;
+			std::memcpy(&size, this->buffer.get() + (position & this->mask), sizeof(size));
+			return size;
+		}
+	public:
+		explicit log_ring(size_t bytes) : capacity(round_to_power_of_two(bytes)), mask(capacity - 1), buffer(std::make_unique<std::byte[]>(capacity)) {}
+		log_ring(const log_ring&) = delete;
+		log_ring& operator=(const log_ring&) = delete;
+		// Largest payload a single record can hold
+		size_t max_record_size() const { return this->capacity / 2 - HEADER_SIZE; }
+
+		// Producer only, returns space for a payload of size bytes, or null if there is not enough room right now
+		// Nothing is visible to the consumer until commit()
+		std::byte* reserve(size_t size)
+		{
+			if (size > this->max_record_size()) return nullptr;
+			size_t position = this->tail.load(std::memory_order_relaxed);
+			size_t offset = position & this->mask;
+			size_t recordSize = HEADER_SIZE + align(size);
+			size_t padding = offset + recordSize > this->capacity ? this->capacity - offset : 0;
+			size_t needed = padding + recordSize;
+			if (this->capacity - (position - this->cachedHead) < needed)
+			{
+				this->cachedHead = this->head.load(std::memory_order_acquire);
+				if (this->capacity - (position - this->cachedHead) < needed) return nullptr;
+			}
+			if (padding != 0)
+			{
+				this->write_header(position, PADDING);
+				position += padding;
+			}
+			this->write_header(position, static_cast<uint32_t>(size));
+			this->pendingTail = position + recordSize;
+			return this->buffer.get() + ((position + HEADER_SIZE) & this->mask);
+		}
+		// Producer only, publishes the record from the last successful reserve()
+		// Sequentially consistent so a consumer that announced it is about to sleep is guaranteed to be seen afterwards
+		void commit() { this->tail.store(this->pendingTail, std::memory_order_seq_cst); }
+
+		// Consumer only, the next record's payload, empty if the ring is empty
+		std::span<const std::byte> peek()
+		{
+			size_t position = this->head.load(std::memory_order_relaxed);
+			if (position == this->cachedTail)
+			{
+				this->cachedTail = this->tail.load(std::memory_order_acquire);
+				if (position == this->cachedTail) return {};
+			}
+			uint32_t size = this->read_header(position);
+			if (size == PADDING)
+			{
+				// Padding is always followed by a record from the same reserve
+				position += this->capacity - (position & this->mask);
+				this->head.store(position, std::memory_order_relaxed);
+				size = this->read_header(position);
+			}
+			return { this->buffer.get() + ((position + HEADER_SIZE) & this->mask), size };
+		}
+		// Consumer only, frees the record returned by the last peek()
+		void pop()
+		{
+			size_t position = this->head.load(std::memory_order_relaxed);
+			this->head.store(position + HEADER_SIZE + align(this->read_header(position)), std::memory_order_release);
+		}
+		// Sequentially consistent for the same reason as commit()
+		bool empty() const { return this->head.load(std::memory_order_relaxed) == this->tail.load(std::memory_order_seq_cst); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "log_sink.hpp"
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cs_std
+{
+	void stdout_sink::write(const log_record_header& header, std::string_view text)
+	{
+		(void)header;
+		std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+	}
+	void stdout_sink::flush() { std::cout.flush(); }
+
+	bool log_file::open(const std::filesystem::path& filePath, bool append)
+	{
+		this->close();
+#if defined(_WIN32)
+		this->descriptor = _wopen(filePath.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (append ? _O_APPEND : _O_TRUNC), _S_IREAD | _S_IWRITE);
+#else
+		this->descriptor = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+#endif
+		if (this->descriptor < 0) return false;
+		std::error_code error;
+		uintmax_t existing = append ? std::filesystem::file_size(filePath, error) : 0;
+		this->fileSize = error ? 0 : existing;
+		return true;
+	}
+	void log_file::write_all(const char* data, size_t size)
+	{
+		while (size != 0)
+		{
+#if defined(_WIN32)
+			int written = _write(this->descriptor, data, static_cast<unsigned int>(std::min<size_t>(size, INT_MAX)));
+#else
+			ssize_t written = ::write(this->descriptor, data, size);
+			if (written < 0 && errno == EINTR) continue;
+#endif
+			// Nowhere to report a failing log file, the rest of the buffer is dropped
+			if (written <= 0) return;
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+	}
+	void log_file::write(const void* data, size_t size)
+	{
+		if (!this->is_open()) return;
+		this->fileSize += size;
+		if (this->used + size > this->buffer.size())
+		{
+			this->flush();
+			// Too large to be worth copying
+			if (size >= this->buffer.size())
+			{
+				this->write_all(static_cast<const char*>(data), size);
+				return;
+			}
+		}
+		std::memcpy(this->buffer.data() + this->used, data, size);
+		this->used += size;
+	}
+	void log_file::flush()
+	{
+		if (this->used == 0) return;
+		this->write_all(this->buffer.data(), this->used);
+		this->used = 0;
+	}
+	void log_file::close()
+	{
+		if (!this->is_open()) return;
+		this->flush();
+#if defined(_WIN32)
+		_close(this->descriptor);
+#else
+		::close(this->descriptor);
+#endif
+		this->descriptor = -1;
+	}
+
+	file_sink::file_sink(const std::filesystem::path& filePath, bool append, size_t bufferBytes) : file(bufferBytes) { this->file.open(filePath, append); }
+	void file_sink::write(const log_record_header& header, std::string_view text)
+	{
+		(void)header;
+		this->file.write(text.data(), text.size());
+	}
+	void file_sink::flush() { this->file.flush(); }
+
+	rotating_file_sink::rotating_file_sink(const std::filesystem::path& filePath, uint64_t maxBytes, std::chrono::seconds maxAge, size_t keepFiles, size_t bufferBytes)
+		: filePath(filePath), maxBytes(maxBytes), maxAgeNanoseconds(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(maxAge).count())), keepFiles(keepFiles), file(bufferBytes)
+	{
+		this->file.open(filePath, true);
+	}
+	std::filesystem::path rotating_file_sink::numbered(size_t index) const
+	{
+		std::filesystem::path result = this->filePath;
+		result += "." + std::to_string(index);
+		return result;
+	}
+	void rotating_file_sink::rotate()
+	{
+		this->file.close();
+		std::error_code error;
+		if (this->keepFiles == 0) std::filesystem::remove(this->filePath, error);
+		else
+		{
+			std::filesystem::remove(this->numbered(this->keepFiles), error);
+			for (size_t i = this->keepFiles - 1; i != 0; i--) std::filesystem::rename(this->numbered(i), this->numbered(i + 1), error);
+			std::filesystem::rename(this->filePath, this->numbered(1), error);
+		}
+		this->file.open(this->filePath, false);
+		this->rotations++;
+	}
+	void rotating_file_sink::write(const log_record_header& header, std::string_view text)
+	{
+		if (this->openedAt == 0) this->openedAt = header.time;
+		bool full = this->file.size() != 0 && this->file.size() + text.size() > this->maxBytes;
+		bool old = this->maxAgeNanoseconds != 0 && header.time - this->openedAt >= this->maxAgeNanoseconds;
+		if (full || old)
+		{
+			this->rotate();
+			this->openedAt = header.time;
+		}
+		this->file.write(text.data(), text.size());
+	}
+	void rotating_file_sink::flush() { this->file.flush(); }
+
+	void memory_sink::write(const log_record_header& header, std::string_view text)
+	{
+		(void)header;
+		std::lock_guard<std::mutex> lock(this->linesMutex);
+		if (this->capacity == 0) return;
+		if (this->history.size() == this->capacity) this->history.pop_front();
+		this->history.emplace_back(text);
+	}
+	std::vector<std::string> memory_sink::lines() const
+	{
+		std::lock_guard<std::mutex> lock(this->linesMutex);
+		return std::vector<std::string>(this->history.begin(), this->history.end());
+	}
+	void memory_sink::clear()
+	{
+		std::lock_guard<std::mutex> lock(this->linesMutex);
+		this->history.clear();
+	}
+
+	binary_file_sink::binary_file_sink(const std::filesystem::path& filePath, size_t bufferBytes) : file(bufferBytes)
+	{
+		if (!this->file.open(filePath, false)) return;
+		this->file.write(LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC));
+		log_chunk chunk = log_chunk::origin;
+		this->file.write(&chunk, sizeof(chunk));
+		this->file.write(&internal::log_origin().wall, sizeof(uint64_t));
+	}
+	void binary_file_sink::write_record(std::span<const std::byte> record)
+	{
+		log_record_header header;
+		std::memcpy(&header, record.data(), sizeof(header));
+		for (; this->signaturesWritten <= header.signature; this->signaturesWritten++)
+		{
+			const std::vector<log_arg_type>& signature = log_signatures::get(this->signaturesWritten);
+			log_chunk chunk = log_chunk::signature;
+			uint16_t count = static_cast<uint16_t>(signature.size());
+			this->file.write(&chunk, sizeof(chunk));
+			this->file.write(&this->signaturesWritten, sizeof(this->signaturesWritten));
+			this->file.write(&count, sizeof(count));
+			this->file.write(signature.data(), signature.size());
+		}
+		log_chunk chunk = log_chunk::record;
+		uint32_t size = static_cast<uint32_t>(record.size());
+		this->file.write(&chunk, sizeof(chunk));
+		this->file.write(&size, sizeof(size));
+		this->file.write(record.data(), record.size());
+	}
+	void binary_file_sink::flush() { this->file.flush(); }
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include "log_record.hpp"
+
+namespace cs_std
+{
+	/// <summary>
+	/// Destination for console output, attached with console::attach
+	/// Calls come from the writer thread in async mode and under the console's lock otherwise, one at a time either way
+	/// Each sink has its own severity mask on top of the console's, raw output is always accepted
+	/// </summary>
+	class log_sink
+	{
+	private:
+		std::atomic<uint8_t> severities = 0xFF;
+	public:
+		virtual ~log_sink() = default;
+		// One formatted message, line break included, header.severity is 0 for raw output
+		virtual void write(const log_record_header& header, std::string_view text) = 0;
+		// Sinks that store records rather than text return true, they get write_record instead of write
+		virtual bool wants_records() const { return false; }
+		// The encoded record, a log_record_header followed by the arguments
+		virtual void write_record(std::span<const std::byte> record) { (void)record; }
+		virtual void flush() {}
+
+		// Takes console::severity_bits flags
+		void severity_mask(uint8_t mask) { this->severities.store(mask, std::memory_order_relaxed); }
+		uint8_t severity_mask() const { return this->severities.load(std::memory_order_relaxed); }
+		bool accepts(uint8_t severity) const { return severity == 0 || (this->severity_mask() & severity) != 0; }
+	};
+
+	/// <summary>
+	/// Writes to std::cout, the sink the console starts with
+	/// </summary>
+	class stdout_sink : public log_sink
+	{
+	public:
+		void write(const log_record_header& header, std::string_view text) override;
+		void flush() override;
+	};
+
+	/// <summary>
+	/// Buffered file writer going straight to write(2), or _write on Windows, instead of through iostreams
+	/// </summary>
+	class log_file
+	{
+	private:
+		int descriptor = -1;
+		std::vector<char> buffer;
+		size_t used = 0;
+		uint64_t fileSize = 0;
+
+		void write_all(const char* data, size_t size);
+	public:
+		explicit log_file(size_t bufferBytes = size_t(1) << 20) : buffer(bufferBytes) {}
+		~log_file() { this->close(); }
+		log_file(const log_file&) = delete;
+		log_file& operator=(const log_file&) = delete;
+		// Truncates the file unless append is set, returns false if it cannot be opened
+		bool open(const std::filesystem::path& filePath, bool append);
+		void write(const void* data, size_t size);
+		// Hands the buffer to the operating system
+		void flush();
+		void close();
+		bool is_open() const { return this->descriptor >= 0; }
+		// Bytes in the file including what is still buffered
+		uint64_t size() const { return this->fileSize; }
+	};
+
+	/// <summary>
+	/// Appends text to a file
+	/// </summary>
+	class file_sink : public log_sink
+	{
+	private:
+		log_file file;
+	public:
+		// Check is_open() for whether the file could be opened
+		explicit file_sink(const std::filesystem::path& filePath, bool append = true, size_t bufferBytes = size_t(1) << 20);
+		void write(const log_record_header& header, std::string_view text) override;
+		void flush() override;
+		bool is_open() const { return this->file.is_open(); }
+	};
+
+	/// <summary>
+	/// Writes text to a file, moving it aside once it reaches maxBytes or has been open for maxAge
+	/// On rotation path becomes path.1, path.1 becomes path.2 and so on, keeping at most keepFiles old files
+	/// </summary>
+	class rotating_file_sink : public log_sink
+	{
+	private:
+		std::filesystem::path filePath;
+		uint64_t maxBytes;
+		// Zero disables rotation by age
+		uint64_t maxAgeNanoseconds;
+		size_t keepFiles;
+		log_file file;
+		// Record time the current file was started at
+		uint64_t openedAt = 0;
+		size_t rotations = 0;
+
+		std::filesystem::path numbered(size_t index) const;
+		void rotate();
+	public:
+		rotating_file_sink(const std::filesystem::path& filePath, uint64_t maxBytes, std::chrono::seconds maxAge = std::chrono::seconds(0), size_t keepFiles = 5, size_t bufferBytes = size_t(1) << 20);
+		void write(const log_record_header& header, std::string_view text) override;
+		void flush() override;
+		bool is_open() const { return this->file.is_open(); }
+		size_t rotation_count() const { return this->rotations; }
+	};
+
+	/// <summary>
+	/// Keeps the last lines written in memory, for crash reports and in-game consoles
+	/// </summary>
+	class memory_sink : public log_sink
+	{
+	private:
+		// Guards the lines against readers on other threads
+		mutable std::mutex linesMutex;
+		std::deque<std::string> history;
+		size_t capacity;
+	public:
+		explicit memory_sink(size_t capacity = 1024) : capacity(capacity) {}
+		void write(const log_record_header& header, std::string_view text) override;
+		// Oldest first
+		std::vector<std::string> lines() const;
+		void clear();
+	};
+
+	/// <summary>
+	/// Writes encoded records instead of text, in the layout described next to LOG_FILE_MAGIC
+	/// tools/log_decoder.cpp turns the file back into text or JSON
+	/// </summary>
+	class binary_file_sink : public log_sink
+	{
+	private:
+		log_file file;
+		// Signature ids are dense, every id below this has been described in the file
+		uint32_t signaturesWritten = 0;
+	public:
+		// Truncates the file, check is_open() for whether it could be opened
+		explicit binary_file_sink(const std::filesystem::path& filePath, size_t bufferBytes = size_t(1) << 20);
+		void write(const log_record_header& header, std::string_view text) override { (void)header; (void)text; }
+		bool wants_records() const override { return true; }
+		void write_record(std::span<const std::byte> record) override;
+		void flush() override;
+		bool is_open() const { return this->file.is_open(); }
+	};
+}
\ No newline at end of file
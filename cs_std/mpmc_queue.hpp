@@ -0,0 +1,146 @@
+#pragma once
+#include <new>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <utility>
+#include <optional>
+#include <cstdint>
+#include "cache_line.hpp"
+
+namespace cs_std
+{
+	/// <summary>
+	/// Lock-free bounded multi producer multi consumer queue
+	/// Power of two ring where each slot carries a sequence number (Dmitry Vyukov's design), slots sit on their own cache line
+	/// </summary>
+	template<typename T, size_t Capacity>
+	class mpmc_queue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "mpmc_queue capacity must be a power of two");
+	private:
+		struct alignas(CACHE_LINE_SIZE) cell
+		{
+			std::atomic<size_t> sequence;
+			alignas(T) unsigned char storage[sizeof(T)];
+
+			T* value() { return std::launder(reinterpret_cast<T*>(this->storage)); }
+		};
+		static constexpr size_t MASK = Capacity - 1;
+		// Attempts a blocking call makes before parking, queues are usually refilled or drained within a few yields
+		static constexpr size_t BLOCKING_SPINS = 16;
+
+		std::unique_ptr<cell[]> cells;
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePosition = 0;
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePosition = 0;
+		// Only touched by the blocking wrappers, or when a blocked thread needs waking
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> pushEvents = 0;
+		std::atomic<uint32_t> waitingConsumers = 0;
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> popEvents = 0;
+		std::atomic<uint32_t> waitingProducers = 0;
+
+		static void signal(std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiting)
+		{
+			// Pairs with the waiter registering itself before its final retry
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_relaxed) == 0) return;
+			events.fetch_add(1, std::memory_order_release);
+			events.notify_one();
+		}
+		// Retries attempt until it succeeds, yields for a short while then parks on events between attempts
+		template<typename F>
+		static auto block(F&& attempt, std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiting)
+		{
+			for (size_t spins = 0; spins < BLOCKING_SPINS; spins++)
+			{
+				auto result = attempt();
+				if (result) return result;
+				std::this_thread::yield();
+			}
+			for (;;)
+			{
+				uint32_t observed = events.load(std::memory_order_acquire);
+				auto result = attempt();
+				if (result) return result;
+				waiting.fetch_add(1, std::memory_order_seq_cst);
+				result = attempt();
+				if (!result) events.wait(observed, std::memory_order_acquire);
+				waiting.fetch_sub(1, std::memory_order_relaxed);
+				if (result) return result;
+			}
+		}
+	public:
+		mpmc_queue() : cells(std::make_unique<cell[]>(Capacity))
+		{
+			for (size_t i = 0; i < Capacity; i++) this->cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		~mpmc_queue()
+		{
+			while (this->try_pop());
+		}
+		mpmc_queue(const mpmc_queue<T, Capacity>& other) = delete;
+		mpmc_queue<T, Capacity>& operator=(const mpmc_queue<T, Capacity>& other) = delete;
+		mpmc_queue(mpmc_queue<T, Capacity>&& other) noexcept = delete;
+		mpmc_queue<T, Capacity>& operator=(mpmc_queue<T, Capacity>&& other) noexcept = delete;
+		// Constructs an element in place, returns false without touching args if the queue is full
+		template<typename... Args>
+		bool try_emplace(Args&&... args)
+		{
+			cell* target;
+			size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				target = &this->cells[position & MASK];
+				intptr_t difference = static_cast<intptr_t>(target->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position);
+				if (difference == 0)
+				{
+					if (this->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+				}
+				else if (difference < 0) return false;
+				else position = this->enqueuePosition.load(std::memory_order_relaxed);
+			}
+			new (target->storage) T(std::forward<Args>(args)...);
+			target->sequence.store(position + 1, std::memory_order_release);
+			signal(this->pushEvents, this->waitingConsumers);
+			return true;
+		}
+		bool try_push(const T& value) { return this->try_emplace(value); }
+		bool try_push(T&& value) { return this->try_emplace(std::move(value)); }
+		// Returns a nullopt if the queue is empty
+		std::optional<T> try_pop()
+		{
+			cell* target;
+			size_t position = this->dequeuePosition.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				target = &this->cells[position & MASK];
+				intptr_t difference = static_cast<intptr_t>(target->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position + 1);
+				if (difference == 0)
+				{
+					if (this->dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+				}
+				else if (difference < 0) return std::nullopt;
+				else position = this->dequeuePosition.load(std::memory_order_relaxed);
+			}
+			std::optional<T> result(std::move(*target->value()));
+			target->value()->~T();
+			target->sequence.store(position + Capacity, std::memory_order_release);
+			signal(this->popEvents, this->waitingProducers);
+			return result;
+		}
+		// Waits till there is room then pushes, the thread yields briefly then sleeps
+		void push(const T& value) { block([&]() { return this->try_emplace(value); }, this->popEvents, this->waitingProducers); }
+		void push(T&& value) { block([&]() { return this->try_emplace(std::move(value)); }, this->popEvents, this->waitingProducers); }
+		// Waits till an element is available then pops it, the thread yields briefly then sleeps
+		T pop() { return std::move(block([&]() { return this->try_pop(); }, this->pushEvents, this->waitingConsumers).value()); }
+		// Approximate size, may be stale by the time it returns
+		size_t size() const
+		{
+			size_t enqueued = this->enqueuePosition.load(std::memory_order_relaxed);
+			size_t dequeued = this->dequeuePosition.load(std::memory_order_relaxed);
+			return enqueued > dequeued ? enqueued - dequeued : 0;
+		}
+		bool empty() const { return this->size() == 0; }
+		static constexpr size_t capacity() { return Capacity; }
+	};
+}
\ No newline at end of file
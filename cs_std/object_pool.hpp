@@ -0,0 +1,79 @@
+#pragma once
+#include <new>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace cs_std
+{
+	/// <summary>
+	/// Thread local cache of fixed size memory blocks
+	/// Blocks may be freed from any thread, they are cached by the freeing thread up to MaxCached blocks
+	/// </summary>
+	template<size_t BlockSize, size_t Alignment = alignof(std::max_align_t), size_t MaxCached = 256>
+	class block_pool
+	{
+	private:
+		struct cache
+		{
+			std::vector<void*> blocks;
+			cache() { this->blocks.reserve(MaxCached); }
+			~cache()
+			{
+				for (void* block : this->blocks) ::operator delete(block, std::align_val_t(Alignment));
+				destroyed = true;
+			}
+		};
+		inline static thread_local cache local;
+		// Trivially destructible so it remains readable after the cache has been torn down during thread exit
+		inline static thread_local bool destroyed = false;
+	public:
+		static void* allocate()
+		{
+			if (!destroyed && !local.blocks.empty())
+			{
+				void* block = local.blocks.back();
+				local.blocks.pop_back();
+				return block;
+			}
+			return ::operator new(BlockSize, std::align_val_t(Alignment));
+		}
+		static void deallocate(void* block)
+		{
+			if (!destroyed && local.blocks.size() < MaxCached)
+			{
+				local.blocks.push_back(block);
+				return;
+			}
+			::operator delete(block, std::align_val_t(Alignment));
+		}
+	};
+
+	// Allocates objects of a single type from a block_pool
+	template<typename T>
+	class object_pool
+	{
+	private:
+		using pool = block_pool<sizeof(T), alignof(T) < alignof(std::max_align_t) ? alignof(std::max_align_t) : alignof(T)>;
+	public:
+		template<typename... Args>
+		static T* create(Args&&... args)
+		{
+			void* block = pool::allocate();
+			try
+			{
+				return new (block) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				pool::deallocate(block);
+				throw;
+			}
+		}
+		static void destroy(T* object)
+		{
+			object->~T();
+			pool::deallocate(object);
+		}
+	};
+}
\ No newline at end of file
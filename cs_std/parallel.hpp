@@ -0,0 +1,173 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include "task_queue.hpp"
+#include "timestamp.hpp"
+
+namespace cs_std
+{
+	namespace internal
+	{
+		// Automatically sized chunks aim for this duration, long enough to amortise scheduling and short enough to balance load
+		constexpr double PARALLEL_TARGET_CHUNK_SECONDS = 50e-6;
+		// Time the calling thread spends running iterations to measure their cost when the grain is picked automatically
+		constexpr double PARALLEL_PROBE_SECONDS = 5e-6;
+		// Minimum chunks per thread, leaves room to rebalance when iterations vary in cost
+		constexpr size_t PARALLEL_CHUNKS_PER_THREAD = 4;
+
+		struct parallel_state
+		{
+			// Starts at one for the calling thread's own share of the work
+			std::atomic<size_t> remaining = 1;
+			// Set by the last finisher once it is done notifying, the state lives on the waiter's stack so it must not return before
+			std::atomic<bool> released = false;
+			std::atomic<bool> failed = false;
+			std::exception_ptr exception;
+
+			// Runs function, keeping the first exception thrown by any chunk
+			template<typename F>
+			void run(F&& function) noexcept
+			{
+				try
+				{
+					function();
+				}
+				catch (...)
+				{
+					if (!this->failed.exchange(true, std::memory_order_acq_rel)) this->exception = std::current_exception();
+				}
+			}
+			void finish()
+			{
+				if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+				this->remaining.notify_all();
+				this->released.store(true, std::memory_order_release);
+			}
+			// Releases the calling thread's share then runs other pending tasks until every chunk is done, only sleeps if the queue is empty
+			void wait(task_queue& queue)
+			{
+				this->finish();
+				for (size_t value = this->remaining.load(std::memory_order_acquire); value != 0; value = this->remaining.load(std::memory_order_acquire))
+				{
+					if (!queue.run_pending_task()) this->remaining.wait(value, std::memory_order_acquire);
+				}
+				// Only the few instructions of the last notify are left
+				while (!this->released.load(std::memory_order_acquire)) std::this_thread::yield();
+				if (this->exception) std::rethrow_exception(this->exception);
+			}
+		};
+
+		template<typename F>
+		struct chunk_splitter
+		{
+			task_queue& queue;
+			parallel_state& state;
+			F& function;
+
+			// Hands the upper half of the range to the queue until a single chunk is left, then runs it
+			void run(size_t first, size_t last)
+			{
+				while (last - first > 1)
+				{
+					size_t middle = first + (last - first) / 2;
+					this->state.remaining.fetch_add(1, std::memory_order_relaxed);
+					this->queue.push_back([this, middle, last]() {
+						this->run(middle, last);
+						this->state.finish();
+					});
+					last = middle;
+				}
+				this->state.run([&]() { this->function(first); });
+			}
+		};
+
+		// Runs function(chunk) for every chunk in [0, chunkCount), the calling thread takes part and returns once all have run
+		template<typename F>
+		void parallel_chunks(task_queue& queue, size_t chunkCount, F&& function)
+		{
+			if (chunkCount == 0) return;
+			parallel_state state;
+			chunk_splitter<std::remove_reference_t<F>> splitter{ queue, state, function };
+			splitter.run(0, chunkCount);
+			state.wait(queue);
+		}
+
+		// Runs iterations from begin on the calling thread until the probe time has passed, then sizes chunks from their measured cost
+		// begin is advanced past the iterations that were run, small loops may finish entirely during the probe
+		template<typename F>
+		size_t measure_grain(task_queue& queue, size_t& begin, size_t end, F& iteration)
+		{
+			timestamp timer;
+			size_t measured = 0;
+			for (size_t batch = 1; begin < end; batch *= 2)
+			{
+				size_t batchEnd = std::min(end, begin + batch);
+				for (; begin < batchEnd; begin++, measured++) iteration(begin);
+				if (timer.elapsed() >= PARALLEL_PROBE_SECONDS) break;
+			}
+			if (begin >= end) return 1;
+
+			double perIteration = timer.elapsed() / static_cast<double>(measured);
+			size_t grain = perIteration > 0.0 ? static_cast<size_t>(PARALLEL_TARGET_CHUNK_SECONDS / perIteration) : end - begin;
+			size_t balanced = (end - begin) / ((queue.thread_count() + 1) * PARALLEL_CHUNKS_PER_THREAD);
+			return std::max<size_t>(1, std::min(grain, balanced));
+		}
+	}
+
+	// Calls function(i) for every i in [begin, end), split into chunks of grain iterations
+	// A grain of 0 picks the chunk size from the measured cost of the first iterations
+	template<typename F>
+	void parallel_for(task_queue& queue, size_t begin, size_t end, size_t grain, F&& function)
+	{
+		if (grain == 0) grain = internal::measure_grain(queue, begin, end, function);
+		if (begin >= end) return;
+		internal::parallel_chunks(queue, (end - begin + grain - 1) / grain, [&](size_t chunk) {
+			size_t first = begin + chunk * grain;
+			size_t last = std::min(end, first + grain);
+			for (size_t i = first; i < last; i++) function(i);
+		});
+	}
+	template<typename F>
+	void parallel_for(task_queue& queue, size_t begin, size_t end, F&& function) { parallel_for(queue, begin, end, 0, function); }
+
+	// Combines function(i) for every i in [begin, end) with reduction, chunk results are combined in index order
+	// A grain of 0 picks the chunk size from the measured cost of the first iterations
+	template<typename T, typename F, typename R>
+	T parallel_reduce(task_queue& queue, size_t begin, size_t end, size_t grain, T identity, F&& function, R&& reduction)
+	{
+		T result = identity;
+		if (grain == 0)
+		{
+			auto probe = [&](size_t i) { result = reduction(std::move(result), function(i)); };
+			grain = internal::measure_grain(queue, begin, end, probe);
+		}
+		if (begin >= end) return result;
+
+		std::vector<T> partials((end - begin + grain - 1) / grain, identity);
+		internal::parallel_chunks(queue, partials.size(), [&](size_t chunk) {
+			size_t first = begin + chunk * grain;
+			size_t last = std::min(end, first + grain);
+			T partial = identity;
+			for (size_t i = first; i < last; i++) partial = reduction(std::move(partial), function(i));
+			partials[chunk] = std::move(partial);
+		});
+		for (T& partial : partials) result = reduction(std::move(result), std::move(partial));
+		return result;
+	}
+	template<typename T, typename F, typename R>
+	T parallel_reduce(task_queue& queue, size_t begin, size_t end, T identity, F&& function, R&& reduction) { return parallel_reduce(queue, begin, end, 0, std::move(identity), function, reduction); }
+
+	// Runs every function concurrently, the calling thread runs some of them itself
+	template<typename... Fs>
+	void parallel_invoke(task_queue& queue, Fs&&... functions)
+	{
+		internal::parallel_chunks(queue, sizeof...(Fs), [&](size_t index) {
+			size_t i = 0;
+			((i++ == index ? static_cast<void>(functions()) : static_cast<void>(0)), ...);
+		});
+	}
+}
\ No newline at end of file
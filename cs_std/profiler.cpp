@@ -0,0 +1,194 @@
+#include "profiler.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <string_view>
+
+namespace cs_std
+{
+	namespace
+	{
+		void write_json_string(std::ostream& stream, std::string_view text)
+		{
+			stream << '"';
+			for (char character : text)
+			{
+				switch (character)
+				{
+				case '"': stream << "\\\""; break;
+				case '\\': stream << "\\\\"; break;
+				case '\n': stream << "\\n"; break;
+				case '\t': stream << "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(character) < 0x20) stream << "\\u00" << "0123456789abcdef"[character >> 4] << "0123456789abcdef"[character & 0xF];
+					else stream << character;
+				}
+			}
+			stream << '"';
+		}
+		// Nanoseconds in the given unit with three decimals
+		void write_scaled(std::ostream& stream, uint64_t nanoseconds, double unit)
+		{
+			char text[32];
+			std::snprintf(text, sizeof(text), "%12.3f", static_cast<double>(nanoseconds) / unit);
+			stream << text;
+		}
+	}
+
+	std::atomic<bool> profiler::isEnabled = true;
+	std::mutex profiler::registryMutex;
+	std::vector<std::unique_ptr<profiler::thread_profile>> profiler::profiles;
+
+	uint64_t profile_node::percentile(double fraction) const
+	{
+		uint64_t samples = 0;
+		for (const std::atomic<uint64_t>& slot : this->histogram) samples += slot.load(std::memory_order_relaxed);
+		if (samples == 0) return 0;
+		uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(samples)));
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKETS; i++)
+		{
+			seen += this->histogram[i].load(std::memory_order_relaxed);
+			if (seen < rank) continue;
+			// The bucket's middle can fall outside what was actually recorded
+			uint64_t value = bucket_value(i);
+			value = std::min(value, this->maximum.load(std::memory_order_relaxed));
+			return std::max(value, this->minimum.load(std::memory_order_relaxed));
+		}
+		return this->maximum.load(std::memory_order_relaxed);
+	}
+
+	profiler::thread_profile& profiler::register_thread()
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		std::unique_ptr<thread_profile> profile = std::make_unique<thread_profile>();
+		profile->id = static_cast<uint32_t>(profiles.size());
+		profile->name = "thread " + std::to_string(profile->id);
+		localProfile = profile.get();
+		profiles.push_back(std::move(profile));
+		return *localProfile;
+	}
+	profile_node* profiler::child(thread_profile& profile, const char* name)
+	{
+		profile_node* last = nullptr;
+		for (profile_node* node = profile.current->firstChild; node != nullptr; node = node->nextSibling)
+		{
+			if (node->name == name) return node;
+			last = node;
+		}
+		// The same name from another translation unit can be a different pointer
+		for (profile_node* node = profile.current->firstChild; node != nullptr; node = node->nextSibling)
+		{
+			if (std::strcmp(node->name, name) == 0) return node;
+		}
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		profile_node* node = &profile.nodes.emplace_back(name, profile.current);
+		if (last == nullptr) profile.current->firstChild = node;
+		else last->nextSibling = node;
+		return node;
+	}
+	void profiler::set_thread_name(std::string name)
+	{
+		thread_profile& profile = localProfile != nullptr ? *localProfile : register_thread();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		profile.name = std::move(name);
+	}
+	void profiler::write_text(std::ostream& stream, const profile_node& node, size_t depth)
+	{
+		for (const profile_node* child = node.firstChild; child != nullptr; child = child->nextSibling)
+		{
+			uint64_t count = child->count.load(std::memory_order_relaxed);
+			uint64_t total = child->total.load(std::memory_order_relaxed);
+			std::string name(depth * 2, ' ');
+			name += child->name;
+			char text[64];
+			std::snprintf(text, sizeof(text), "%-40s%12llu", name.c_str(), static_cast<unsigned long long>(count));
+			stream << text;
+			write_scaled(stream, total, 1e6);
+			write_scaled(stream, count != 0 ? total / count : 0, 1e3);
+			write_scaled(stream, count != 0 ? child->minimum.load(std::memory_order_relaxed) : 0, 1e3);
+			write_scaled(stream, child->maximum.load(std::memory_order_relaxed), 1e3);
+			write_scaled(stream, child->percentile(0.99), 1e3);
+			stream << '\n';
+			write_text(stream, *child, depth + 1);
+		}
+	}
+	void profiler::write_text(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		for (const auto& profile : profiles)
+		{
+			std::lock_guard<std::mutex> lock(profile->mutex);
+			if (profile->nodes.front().firstChild == nullptr) continue;
+			char text[128];
+			std::snprintf(text, sizeof(text), "%-40s%12s%12s%12s%12s%12s%12s\n", profile->name.c_str(), "count", "total ms", "mean us", "min us", "max us", "p99 us");
+			stream << text;
+			write_text(stream, profile->nodes.front(), 1);
+			stream << '\n';
+		}
+	}
+	void profiler::write_json(std::ostream& stream, const profile_node& node)
+	{
+		stream << '[';
+		for (const profile_node* child = node.firstChild; child != nullptr; child = child->nextSibling)
+		{
+			uint64_t count = child->count.load(std::memory_order_relaxed);
+			uint64_t total = child->total.load(std::memory_order_relaxed);
+			stream << "{\"name\":";
+			write_json_string(stream, child->name);
+			stream << ",\"count\":" << count << ",\"totalNs\":" << total << ",\"meanNs\":" << (count != 0 ? total / count : 0);
+			stream << ",\"minNs\":" << (count != 0 ? child->minimum.load(std::memory_order_relaxed) : 0) << ",\"maxNs\":" << child->maximum.load(std::memory_order_relaxed);
+			stream << ",\"p99Ns\":" << child->percentile(0.99) << ",\"children\":";
+			write_json(stream, *child);
+			stream << (child->nextSibling != nullptr ? "}," : "}");
+		}
+		stream << ']';
+	}
+	void profiler::write_json(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		stream << "{\"threads\":[";
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			std::lock_guard<std::mutex> lock(profiles[i]->mutex);
+			stream << "{\"name\":";
+			write_json_string(stream, profiles[i]->name);
+			stream << ",\"zones\":";
+			write_json(stream, profiles[i]->nodes.front());
+			stream << (i + 1 < profiles.size() ? "}," : "}");
+		}
+		stream << "]}\n";
+	}
+	bool profiler::save_text(const std::filesystem::path& filePath)
+	{
+		std::ofstream stream(filePath, std::ios::binary);
+		if (!stream) return false;
+		write_text(stream);
+		return static_cast<bool>(stream);
+	}
+	bool profiler::save_json(const std::filesystem::path& filePath)
+	{
+		std::ofstream stream(filePath, std::ios::binary);
+		if (!stream) return false;
+		write_json(stream);
+		return static_cast<bool>(stream);
+	}
+	void profiler::clear()
+	{
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		for (const auto& profile : profiles)
+		{
+			std::lock_guard<std::mutex> lock(profile->mutex);
+			for (profile_node& node : profile->nodes)
+			{
+				node.count.store(0, std::memory_order_relaxed);
+				node.total.store(0, std::memory_order_relaxed);
+				node.minimum.store(UINT64_MAX, std::memory_order_relaxed);
+				node.maximum.store(0, std::memory_order_relaxed);
+				for (std::atomic<uint64_t>& slot : node.histogram) slot.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <bit>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include "timestamp.hpp"
+
+// Profiling zones are compiled in by default and cheap enough to leave on, define CS_STD_DISABLE_PROFILING for every
+// translation unit or none to compile them out, CS_PROFILE_SCOPE then expands to nothing
+#ifndef CS_STD_DISABLE_PROFILING
+#define CS_PROFILE_CONCAT_INNER(a, b) a##b
+#define CS_PROFILE_CONCAT(a, b) CS_PROFILE_CONCAT_INNER(a, b)
+#define CS_PROFILE_SCOPE(name) cs_std::profile_scope CS_PROFILE_CONCAT(csProfileScope, __LINE__)(name)
+#define CS_PROFILE_THREAD_NAME(name) cs_std::profiler::set_thread_name(name)
+#else
+#define CS_PROFILE_SCOPE(name) ((void)0)
+#define CS_PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+namespace cs_std
+{
+	/// <summary>
+	/// Accumulated timings of one zone at one place in a thread's call tree
+	/// Only the owning thread writes the statistics, relaxed atomics let a report read them while it does
+	/// </summary>
+	struct profile_node
+	{
+		// Durations are kept in a log-linear histogram for percentiles, 8 buckets per power of two, so within 6.25%
+		static constexpr size_t SUB_BUCKETS = 8;
+		static constexpr size_t BUCKETS = (64 - 2) * SUB_BUCKETS;
+
+		// Must outlive the profiler, in practice a string literal
+		const char* name;
+		profile_node* parent;
+		// Children in the order they were first entered, linked under the thread's mutex so reports can walk them
+		profile_node* firstChild = nullptr;
+		profile_node* nextSibling = nullptr;
+		// Child entered last, checked first, owner only
+		profile_node* lastChild = nullptr;
+		std::atomic<uint64_t> count = 0;
+		std::atomic<uint64_t> total = 0;
+		std::atomic<uint64_t> minimum = UINT64_MAX;
+		std::atomic<uint64_t> maximum = 0;
+		std::array<std::atomic<uint64_t>, BUCKETS> histogram = {};
+
+		profile_node(const char* name, profile_node* parent) : name(name), parent(parent) {}
+		static size_t bucket(uint64_t nanoseconds)
+		{
+			if (nanoseconds < SUB_BUCKETS) return static_cast<size_t>(nanoseconds);
+			size_t octave = static_cast<size_t>(std::bit_width(nanoseconds)) - 1;
+			return (octave - 2) * SUB_BUCKETS + static_cast<size_t>((nanoseconds >> (octave - 3)) & (SUB_BUCKETS - 1));
+		}
+		// Middle of the bucket's range
+		static uint64_t bucket_value(size_t index)
+		{
+			if (index < SUB_BUCKETS) return index;
+			size_t octave = index / SUB_BUCKETS + 2;
+			uint64_t width = uint64_t(1) << (octave - 3);
+			return (SUB_BUCKETS + index % SUB_BUCKETS) * width + width / 2;
+		}
+		// Owner only, plain loads and stores since nothing else writes
+		void add(uint64_t nanoseconds)
+		{
+			this->count.store(this->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			this->total.store(this->total.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+			if (nanoseconds < this->minimum.load(std::memory_order_relaxed)) this->minimum.store(nanoseconds, std::memory_order_relaxed);
+			if (nanoseconds > this->maximum.load(std::memory_order_relaxed)) this->maximum.store(nanoseconds, std::memory_order_relaxed);
+			std::atomic<uint64_t>& slot = this->histogram[bucket(nanoseconds)];
+			slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		// Estimated duration below which the given fraction of the samples fall
+		uint64_t percentile(double fraction) const;
+	};
+
+	/// <summary>
+	/// Per thread hierarchical zone timings, fed by CS_PROFILE_SCOPE
+	/// Each thread builds its own call tree and only locks when a zone first appears at a new place in it
+	/// Reports read every thread's tree while they keep running, the numbers of a zone may be one sample apart from each other
+	/// </summary>
+	class profiler
+	{
+	private:
+		struct thread_profile
+		{
+			// Guards the node list and child links against reports, the owner only takes it to add a node
+			std::mutex mutex;
+			// A deque so nodes never move
+			std::deque<profile_node> nodes;
+			profile_node* current;
+			uint32_t id;
+			std::string name;
+
+			thread_profile() : current(&this->nodes.emplace_back("", nullptr)) {}
+		};
+
+		static std::atomic<bool> isEnabled;
+		// Guards the profile list, profiles of exited threads are kept for reports
+		static std::mutex registryMutex;
+		static std::vector<std::unique_ptr<thread_profile>> profiles;
+		inline static thread_local thread_profile* localProfile = nullptr;
+
+		static thread_profile& register_thread();
+		// Finds or adds the named child of the current node
+		static profile_node* child(thread_profile& profile, const char* name);
+		static void write_text(std::ostream& stream, const profile_node& node, size_t depth);
+		static void write_json(std::ostream& stream, const profile_node& node);
+	public:
+		// Makes name the calling thread's current zone, null if profiling is paused
+		static profile_node* enter(const char* name)
+		{
+			if (!isEnabled.load(std::memory_order_relaxed)) return nullptr;
+			thread_profile& profile = localProfile != nullptr ? *localProfile : register_thread();
+			profile_node* node = profile.current->lastChild;
+			// Pointers match for the same literal, a copy of it from another translation unit only costs a strcmp instead of a sibling search
+			if (node == nullptr || (node->name != name && std::strcmp(node->name, name) != 0)) node = child(profile, name);
+			profile.current->lastChild = node;
+			profile.current = node;
+			return node;
+		}
+		// Records a zone entered with enter and makes its parent current again
+		static void exit(profile_node& node, uint64_t nanoseconds)
+		{
+			node.add(nanoseconds);
+			localProfile->current = node.parent;
+		}
+		// Name shown for the calling thread, defaults to "thread n"
+		static void set_thread_name(std::string name);
+		// Profiling can be paused at runtime, each zone then costs one relaxed load
+		static void enable(bool enabled) { isEnabled.store(enabled, std::memory_order_relaxed); }
+		static bool enabled() { return isEnabled.load(std::memory_order_relaxed); }
+
+		// Every thread's call tree with count, total, mean, min, max and p99 of each zone, as an indented table
+		static void write_text(std::ostream& stream);
+		// The same as JSON, {"threads":[{"name", "zones":[{"name", "count", "totalNs", "meanNs", "minNs", "maxNs", "p99Ns", "children":[...]}]}]}
+		static void write_json(std::ostream& stream);
+		static bool save_text(const std::filesystem::path& filePath);
+		static bool save_json(const std::filesystem::path& filePath);
+		// Zeroes every statistic, the call trees are kept, samples being recorded at the same time may survive it
+		static void clear();
+	};
+
+	/// <summary>
+	/// Times the enclosing scope as a zone nested under whatever zone the thread is already in
+	/// </summary>
+	class profile_scope
+	{
+	private:
+		profile_node* node;
+		// Started after entering so the lookup is not counted, and not at all while profiling is paused
+		std::optional<timestamp> time;
+	public:
+		explicit profile_scope(const char* name) : node(profiler::enter(name)) { if (this->node != nullptr) this->time.emplace(); }
+		~profile_scope() { if (this->node != nullptr) profiler::exit(*this->node, this->time->nanoseconds()); }
+		profile_scope(const profile_scope&) = delete;
+		profile_scope& operator=(const profile_scope&) = delete;
+	};
+}
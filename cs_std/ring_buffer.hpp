@@ -0,0 +1,107 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <stdexcept>
+
+namespace cs_std
+{
+	/// <summary>
+	/// Growable power of two ring buffer with a std::queue like interface
+	/// Storage is reused as elements are pushed and popped, it only allocates when it needs to grow
+	/// </summary>
+	template<typename T>
+	class ring_buffer
+	{
+	public:
+		typedef T value_type;
+		typedef size_t size_type;
+		typedef T& reference;
+		typedef const T& const_reference;
+	private:
+		T* items;
+		size_t capacity;
+		size_t head;
+		size_t count;
+
+		T* slot(size_t index) const { return this->items + ((this->head + index) & (this->capacity - 1)); }
+		void grow()
+		{
+			size_t newCapacity = this->capacity == 0 ? 16 : this->capacity * 2;
+			T* newItems = static_cast<T*>(::operator new(sizeof(T) * newCapacity, std::align_val_t(alignof(T))));
+			for (size_t i = 0; i < this->count; i++)
+			{
+				T* old = this->slot(i);
+				new (newItems + i) T(std::move(*old));
+				old->~T();
+			}
+			this->release_storage();
+			this->items = newItems;
+			this->capacity = newCapacity;
+			this->head = 0;
+		}
+		void release_storage()
+		{
+			if (this->items != nullptr) ::operator delete(this->items, std::align_val_t(alignof(T)));
+		}
+	public:
+		explicit ring_buffer(size_t initialCapacity = 0) : items(nullptr), capacity(0), head(0), count(0)
+		{
+			while (this->capacity < initialCapacity) this->grow();
+		}
+		~ring_buffer()
+		{
+			this->clear();
+			this->release_storage();
+		}
+		ring_buffer(const ring_buffer<T>& other) = delete;
+		ring_buffer<T>& operator=(const ring_buffer<T>& other) = delete;
+		ring_buffer(ring_buffer<T>&& other) noexcept :
+			items(std::exchange(other.items, nullptr)), capacity(std::exchange(other.capacity, 0)), head(std::exchange(other.head, 0)), count(std::exchange(other.count, 0)) {}
+		ring_buffer<T>& operator=(ring_buffer<T>&& other) noexcept
+		{
+			if (this == &other) return *this;
+			this->clear();
+			this->release_storage();
+			this->items = std::exchange(other.items, nullptr);
+			this->capacity = std::exchange(other.capacity, 0);
+			this->head = std::exchange(other.head, 0);
+			this->count = std::exchange(other.count, 0);
+			return *this;
+		}
+		void swap(ring_buffer<T>& other) noexcept
+		{
+			std::swap(this->items, other.items);
+			std::swap(this->capacity, other.capacity);
+			std::swap(this->head, other.head);
+			std::swap(this->count, other.count);
+		}
+		template<typename... Args>
+		T& emplace(Args&&... args)
+		{
+			if (this->count == this->capacity) this->grow();
+			T* item = new (this->slot(this->count)) T(std::forward<Args>(args)...);
+			this->count++;
+			return *item;
+		}
+		void push(const T& value) { this->emplace(value); }
+		void push(T&& value) { this->emplace(std::move(value)); }
+		T& front() { return *this->slot(0); }
+		const T& front() const { return *this->slot(0); }
+		T& back() { return *this->slot(this->count - 1); }
+		const T& back() const { return *this->slot(this->count - 1); }
+		void pop()
+		{
+			this->slot(0)->~T();
+			this->head = (this->head + 1) & (this->capacity - 1);
+			this->count--;
+		}
+		void clear()
+		{
+			while (this->count > 0) this->pop();
+			this->head = 0;
+		}
+		bool empty() const { return this->count == 0; }
+		size_t size() const { return this->count; }
+	};
+}
\ No newline at end of file
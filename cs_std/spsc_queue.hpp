@@ -0,0 +1,122 @@
+#pragma once
+#include <new>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include "cache_line.hpp"
+
+namespace cs_std
+{
+	/// <summary>
+	/// Wait-free bounded single producer single consumer ring
+	/// Each side caches the other's index and only rereads it when the cached value says the ring is full or empty
+	/// push_n and pop_n move whole spans so a single index handoff transfers many elements
+	/// </summary>
+	template<typename T, size_t Capacity>
+	class spsc_queue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "spsc_queue capacity must be a power of two");
+	private:
+		static constexpr size_t MASK = Capacity - 1;
+
+		struct deleter { void operator()(T* items) const { ::operator delete(items, std::align_val_t(alignof(T))); } };
+		std::unique_ptr<T, deleter> items;
+		// Consumer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> head = 0;
+		size_t cachedTail = 0;
+		// Producer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail = 0;
+		size_t cachedHead = 0;
+
+		T* slot(size_t index) const { return this->items.get() + (index & MASK); }
+		// Producer only, number of free slots, rereads the consumer index only when the cache says there is not enough room
+		size_t writable(size_t position, size_t wanted)
+		{
+			size_t available = Capacity - (position - this->cachedHead);
+			if (available >= wanted) return available;
+			this->cachedHead = this->head.load(std::memory_order_acquire);
+			return Capacity - (position - this->cachedHead);
+		}
+		// Consumer only, number of filled slots, rereads the producer index only when the cache says there are not enough elements
+		size_t readable(size_t position, size_t wanted)
+		{
+			size_t available = this->cachedTail - position;
+			if (available >= wanted) return available;
+			this->cachedTail = this->tail.load(std::memory_order_acquire);
+			return this->cachedTail - position;
+		}
+	public:
+		spsc_queue() : items(static_cast<T*>(::operator new(sizeof(T) * Capacity, std::align_val_t(alignof(T))))) {}
+		~spsc_queue()
+		{
+			size_t end = this->tail.load(std::memory_order_relaxed);
+			for (size_t i = this->head.load(std::memory_order_relaxed); i != end; i++) this->slot(i)->~T();
+		}
+		spsc_queue(const spsc_queue<T, Capacity>& other) = delete;
+		spsc_queue<T, Capacity>& operator=(const spsc_queue<T, Capacity>& other) = delete;
+		spsc_queue(spsc_queue<T, Capacity>&& other) noexcept = delete;
+		spsc_queue<T, Capacity>& operator=(spsc_queue<T, Capacity>&& other) noexcept = delete;
+		// Producer only, constructs an element in place, returns false without touching args if the ring is full
+		template<typename... Args>
+		bool try_emplace(Args&&... args)
+		{
+			size_t position = this->tail.load(std::memory_order_relaxed);
+			if (this->writable(position, 1) == 0) return false;
+			new (this->slot(position)) T(std::forward<Args>(args)...);
+			this->tail.store(position + 1, std::memory_order_release);
+			return true;
+		}
+		bool try_push(const T& value) { return this->try_emplace(value); }
+		bool try_push(T&& value) { return this->try_emplace(std::move(value)); }
+		// Producer only, copies as many elements as fit and returns how many were pushed
+		size_t push_n(std::span<const T> values)
+		{
+			size_t position = this->tail.load(std::memory_order_relaxed);
+			size_t count = std::min(values.size(), this->writable(position, values.size()));
+			if (count == 0) return 0;
+			// At most two contiguous runs, before and after the wrap point
+			size_t first = std::min(count, Capacity - (position & MASK));
+			std::uninitialized_copy_n(values.data(), first, this->slot(position));
+			std::uninitialized_copy_n(values.data() + first, count - first, this->items.get());
+			this->tail.store(position + count, std::memory_order_release);
+			return count;
+		}
+		// Consumer only, returns a nullopt if the ring is empty
+		std::optional<T> try_pop()
+		{
+			size_t position = this->head.load(std::memory_order_relaxed);
+			if (this->readable(position, 1) == 0) return std::nullopt;
+			T* item = this->slot(position);
+			std::optional<T> result(std::move(*item));
+			item->~T();
+			this->head.store(position + 1, std::memory_order_release);
+			return result;
+		}
+		// Consumer only, moves up to destination.size() elements out and returns how many were popped
+		size_t pop_n(std::span<T> destination)
+		{
+			size_t position = this->head.load(std::memory_order_relaxed);
+			size_t count = std::min(destination.size(), this->readable(position, destination.size()));
+			if (count == 0) return 0;
+			size_t first = std::min(count, Capacity - (position & MASK));
+			std::move(this->slot(position), this->slot(position) + first, destination.data());
+			std::move(this->items.get(), this->items.get() + (count - first), destination.data() + first);
+			std::destroy_n(this->slot(position), first);
+			std::destroy_n(this->items.get(), count - first);
+			this->head.store(position + count, std::memory_order_release);
+			return count;
+		}
+		// Approximate from any thread other than the producer or consumer
+		// Head is read first so the later tail is never behind it, both can move in between so the result is clamped to the capacity
+		size_t size() const
+		{
+			size_t position = this->head.load(std::memory_order_acquire);
+			return std::min(this->tail.load(std::memory_order_acquire) - position, Capacity);
+		}
+		bool empty() const { return this->size() == 0; }
+		static constexpr size_t capacity() { return Capacity; }
+	};
+}
\ No newline at end of file
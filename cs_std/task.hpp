@@ -0,0 +1,95 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include <functional>
+
+namespace cs_std
+{
+	/// <summary>
+	/// Move only type erased void() callable with an inline capture buffer
+	/// Callables that fit in InlineSize bytes and are nothrow movable never allocate, larger ones fall back to the heap
+	/// </summary>
+	template<size_t InlineSize = 64>
+	class basic_task
+	{
+	private:
+		struct operations
+		{
+			void (*invoke)(void* storage);
+			// Move constructs into destination and destroys the source
+			void (*relocate)(void* destination, void* source) noexcept;
+			void (*destroy)(void* storage) noexcept;
+		};
+		template<typename F>
+		static constexpr bool stored_inline = sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+		template<typename F>
+		static constexpr operations inline_operations = {
+			[](void* storage) { std::invoke(*static_cast<F*>(storage)); },
+			[](void* destination, void* source) noexcept {
+				new (destination) F(std::move(*static_cast<F*>(source)));
+				static_cast<F*>(source)->~F();
+			},
+			[](void* storage) noexcept { static_cast<F*>(storage)->~F(); },
+		};
+		template<typename F>
+		static constexpr operations heap_operations = {
+			[](void* storage) { std::invoke(**static_cast<F**>(storage)); },
+			[](void* destination, void* source) noexcept { *static_cast<F**>(destination) = *static_cast<F**>(source); },
+			[](void* storage) noexcept { delete *static_cast<F**>(storage); },
+		};
+
+		alignas(std::max_align_t) unsigned char storage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+		const operations* ops;
+	public:
+		basic_task() noexcept : ops(nullptr) {}
+		basic_task(std::nullptr_t) noexcept : ops(nullptr) {}
+		template<typename F> requires (!std::is_same_v<std::decay_t<F>, basic_task<InlineSize>> && std::is_invocable_v<std::decay_t<F>&>)
+		basic_task(F&& function)
+		{
+			using callable = std::decay_t<F>;
+			if constexpr (stored_inline<callable>)
+			{
+				new (this->storage) callable(std::forward<F>(function));
+				this->ops = &inline_operations<callable>;
+			}
+			else
+			{
+				*reinterpret_cast<callable**>(this->storage) = new callable(std::forward<F>(function));
+				this->ops = &heap_operations<callable>;
+			}
+		}
+		~basic_task() { this->reset(); }
+		basic_task(const basic_task<InlineSize>&) = delete;
+		basic_task<InlineSize>& operator=(const basic_task<InlineSize>&) = delete;
+		basic_task(basic_task<InlineSize>&& other) noexcept : ops(other.ops)
+		{
+			if (this->ops != nullptr) this->ops->relocate(this->storage, other.storage);
+			other.ops = nullptr;
+		}
+		basic_task<InlineSize>& operator=(basic_task<InlineSize>&& other) noexcept
+		{
+			if (this == &other) return *this;
+			this->reset();
+			this->ops = other.ops;
+			if (this->ops != nullptr) this->ops->relocate(this->storage, other.storage);
+			other.ops = nullptr;
+			return *this;
+		}
+		void reset() noexcept
+		{
+			if (this->ops == nullptr) return;
+			this->ops->destroy(this->storage);
+			this->ops = nullptr;
+		}
+		void operator()() { this->ops->invoke(this->storage); }
+		explicit operator bool() const noexcept { return this->ops != nullptr; }
+		// True if the callable F would be stored without allocating
+		template<typename F>
+		static constexpr bool fits_inline() { return stored_inline<std::decay_t<F>>; }
+	};
+
+	using task = basic_task<64>;
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <initializer_list>
+#include <limits>
+#include "task_queue.hpp"
+
+namespace cs_std
+{
+	/// <summary>
+	/// Graph of tasks where each node runs once all of its predecessors have finished
+	/// Successors are dispatched by whichever thread finishes their last dependency, there are no barriers between stages
+	/// A built graph can be run again and again without allocating
+	/// </summary>
+	class task_graph
+	{
+	public:
+		typedef size_t node_id;
+	private:
+		struct node
+		{
+			cs_std::task function;
+			task_priority priority;
+			std::vector<node_id> successors;
+			size_t predecessorCount = 0;
+			// Dependencies still outstanding in the current run
+			std::atomic<size_t> pending = 0;
+
+			node(cs_std::task&& function, task_priority priority) : function(std::move(function)), priority(priority) {}
+		};
+		std::vector<std::unique_ptr<node>> nodes;
+		std::vector<node_id> roots;
+		task_queue* queue = nullptr;
+		bool built = false;
+		// Nodes not yet finished in the current run
+		std::atomic<size_t> remaining = 0;
+		// Cleared by run() and set by the last node once it is done notifying, until then the graph is still in use
+		std::atomic<bool> settled = true;
+		std::atomic<bool> failed = false;
+		std::exception_ptr exception;
+
+		void dispatch(node_id id) { this->queue->push_back([this, id]() { this->execute(id); }, this->nodes[id]->priority); }
+		// Runs a node then releases its successors, one ready successor is run directly on this thread instead of going through the queue
+		void execute(node_id id)
+		{
+			while (id != NO_NODE)
+			{
+				node& current = *this->nodes[id];
+				try
+				{
+					current.function();
+				}
+				catch (...)
+				{
+					if (!this->failed.exchange(true, std::memory_order_acq_rel)) this->exception = std::current_exception();
+				}
+				node_id next = NO_NODE;
+				for (node_id successor : current.successors)
+				{
+					if (this->nodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+					if (next != NO_NODE) this->dispatch(next);
+					next = successor;
+				}
+				if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					this->remaining.notify_all();
+					this->settled.store(true, std::memory_order_release);
+					return;
+				}
+				id = next;
+			}
+		}
+	public:
+		static constexpr node_id NO_NODE = std::numeric_limits<node_id>::max();
+
+		task_graph() = default;
+		~task_graph() = default;
+		task_graph(const task_graph&) = delete;
+		task_graph& operator=(const task_graph&) = delete;
+		task_graph(task_graph&&) = delete;
+		task_graph& operator=(task_graph&&) = delete;
+		// Adds a node that runs after every node in predecessors
+		node_id add(cs_std::task function, std::initializer_list<node_id> predecessors = {}, task_priority priority = task_priority::normal)
+		{
+			node_id id = this->nodes.size();
+			this->nodes.emplace_back(std::make_unique<node>(std::move(function), priority));
+			for (node_id predecessor : predecessors) this->precede(predecessor, id);
+			this->built = false;
+			return id;
+		}
+		// Makes after wait for before
+		void precede(node_id before, node_id after)
+		{
+			if (before >= this->nodes.size() || after >= this->nodes.size()) throw std::out_of_range("task_graph node does not exist.");
+			this->nodes[before]->successors.push_back(after);
+			this->nodes[after]->predecessorCount++;
+			this->built = false;
+		}
+		// Finds the root nodes and checks the graph has no cycles, called automatically by the first run after a change
+		void build()
+		{
+			if (this->running()) throw std::logic_error("Cannot rebuild a task_graph while it is running.");
+			this->roots.clear();
+			std::vector<size_t> inDegree(this->nodes.size());
+			std::vector<node_id> order;
+			order.reserve(this->nodes.size());
+			for (node_id id = 0; id < this->nodes.size(); id++)
+			{
+				inDegree[id] = this->nodes[id]->predecessorCount;
+				if (inDegree[id] == 0)
+				{
+					this->roots.push_back(id);
+					order.push_back(id);
+				}
+			}
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				for (node_id successor : this->nodes[order[i]]->successors) if (--inDegree[successor] == 0) order.push_back(successor);
+			}
+			if (order.size() != this->nodes.size()) throw std::logic_error("task_graph contains a cycle.");
+			this->built = true;
+		}
+		// Starts a run on the queue and returns immediately, use wait() to block until every node has finished
+		void run(task_queue& taskQueue)
+		{
+			if (this->running()) throw std::logic_error("task_graph is already running.");
+			if (!this->built) this->build();
+			if (this->nodes.empty()) return;
+
+			this->queue = &taskQueue;
+			this->failed.store(false, std::memory_order_relaxed);
+			this->exception = nullptr;
+			for (auto& current : this->nodes) current->pending.store(current->predecessorCount, std::memory_order_relaxed);
+			this->settled.store(false, std::memory_order_relaxed);
+			this->remaining.store(this->nodes.size(), std::memory_order_release);
+			for (node_id root : this->roots) this->dispatch(root);
+		}
+		// Blocks until the current run finishes, the calling thread runs other pending tasks while it waits
+		// Rethrows the first exception thrown by a node
+		void wait()
+		{
+			for (size_t value = this->remaining.load(std::memory_order_acquire); value != 0; value = this->remaining.load(std::memory_order_acquire))
+			{
+				if (!this->queue->run_pending_task()) this->remaining.wait(value, std::memory_order_acquire);
+			}
+			// Only the few instructions of the last notify are left
+			while (!this->settled.load(std::memory_order_acquire)) std::this_thread::yield();
+			if (this->exception) std::rethrow_exception(this->exception);
+		}
+		void run_and_wait(task_queue& taskQueue)
+		{
+			this->run(taskQueue);
+			this->wait();
+		}
+		// Stays true until the last node has stopped touching the graph, so a graph polled to completion is safe to destroy
+		bool running() const { return !this->settled.load(std::memory_order_acquire); }
+		size_t size() const { return this->nodes.size(); }
+		void clear()
+		{
+			if (this->running()) throw std::logic_error("Cannot clear a task_graph while it is running.");
+			this->nodes.clear();
+			this->roots.clear();
+			this->built = false;
+		}
+	};
+}
\ No newline at end of file
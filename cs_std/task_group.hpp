@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <limits>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "task_queue.hpp"
+#include "object_pool.hpp"
+
+namespace cs_std
+{
+	// Thrown out of the handle of a submitted task that was cancelled before it started
+	class task_cancelled : public std::runtime_error
+	{
+	public:
+		task_cancelled() : std::runtime_error("Task was cancelled before it started.") {}
+	};
+
+	/// <summary>
+	/// Shared view of a task_group's cancellation, cheap to copy into tasks and safe to keep after the group is gone
+	/// Tasks poll it at convenient points and return early once it is set
+	/// </summary>
+	class cancellation_token
+	{
+	private:
+		std::shared_ptr<const std::atomic<bool>> flag;
+	public:
+		cancellation_token() = default;
+		explicit cancellation_token(std::shared_ptr<const std::atomic<bool>> flag) : flag(std::move(flag)) {}
+		// A default constructed token is never cancelled
+		bool cancelled() const { return this->flag != nullptr && this->flag->load(std::memory_order_relaxed); }
+		explicit operator bool() const { return this->cancelled(); }
+	};
+
+	/// <summary>
+	/// Set of tasks on a task_queue that can be waited on and cancelled together
+	/// Cancelling drops every task of the group that has not started yet, running tasks see it through the group's token
+	/// The destructor cancels and waits, so no task outlives its group
+	/// </summary>
+	class task_group
+	{
+	private:
+		task_queue& queue;
+		std::shared_ptr<std::atomic<bool>> cancelFlag;
+		// The low bits count tasks pushed through the group that have not finished or been dropped yet, the top bits count tasks
+		// that took that count to zero and are still notifying waiters, the group stays in use until both are zero
+		static constexpr size_t NOTIFYING = size_t(1) << (std::numeric_limits<size_t>::digits - 12);
+		static constexpr size_t COUNT_MASK = NOTIFYING - 1;
+		std::atomic<size_t> outstanding = 0;
+		std::atomic<bool> failed = false;
+		std::exception_ptr exception;
+
+		void finish()
+		{
+			// The last task registers as notifying in the same step that takes the count to zero, so no waiter can return in between
+			size_t value = this->outstanding.load(std::memory_order_relaxed);
+			while (!this->outstanding.compare_exchange_weak(value, (value & COUNT_MASK) == 1 ? value - 1 + NOTIFYING : value - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+			if ((value & COUNT_MASK) != 1) return;
+			this->outstanding.notify_all();
+			this->outstanding.fetch_sub(NOTIFYING, std::memory_order_release);
+		}
+		// Runs other pending tasks until every task of the group is done and no finisher is still notifying
+		void wait_until_idle()
+		{
+			for (size_t value = this->outstanding.load(std::memory_order_acquire); value != 0; value = this->outstanding.load(std::memory_order_acquire))
+			{
+				// Only the few instructions of a notify are left
+				if ((value & COUNT_MASK) == 0) std::this_thread::yield();
+				else if (!this->queue.run_pending_task()) this->outstanding.wait(value, std::memory_order_acquire);
+			}
+		}
+		// Wrapped tasks only carry a pointer to the user's task, kept in a pooled node, so they still fit inline
+		void enqueue(cs_std::task&& function, task_priority priority)
+		{
+			this->outstanding.fetch_add(1, std::memory_order_relaxed);
+			cs_std::task* pooled = object_pool<cs_std::task>::create(std::move(function));
+			this->queue.push_back([this, pooled]() {
+				if (!this->cancelled())
+				{
+					try
+					{
+						(*pooled)();
+					}
+					catch (...)
+					{
+						if (!this->failed.exchange(true, std::memory_order_acq_rel)) this->exception = std::current_exception();
+					}
+				}
+				object_pool<cs_std::task>::destroy(pooled);
+				this->finish();
+			}, priority);
+		}
+	public:
+		explicit task_group(task_queue& queue) : queue(queue), cancelFlag(std::make_shared<std::atomic<bool>>(false)) {}
+		~task_group()
+		{
+			this->cancel();
+			this->wait_until_idle();
+		}
+		task_group(const task_group&) = delete;
+		task_group& operator=(const task_group&) = delete;
+		task_group(task_group&&) = delete;
+		task_group& operator=(task_group&&) = delete;
+		// Functions taking a cancellation_token are passed the group's token
+		template<typename F>
+		void push_back(F&& function, task_priority priority = task_priority::normal)
+		{
+			if constexpr (std::is_invocable_v<std::decay_t<F>&, const cancellation_token&>) this->enqueue([function = std::forward<F>(function), token = this->token()]() mutable { function(token); }, priority);
+			else this->enqueue(cs_std::task(std::forward<F>(function)), priority);
+		}
+		// Like task_queue::submit, the handle fails with task_cancelled if the group is cancelled before the task starts
+		template<typename F, typename... Args>
+		task_handle<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>&...>> submit(F&& function, Args&&... args)
+		{
+			using R = std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>&...>;
+			internal::task_state<R>* state = internal::task_state<R>::create(&this->queue, 2);
+			this->outstanding.fetch_add(1, std::memory_order_relaxed);
+			this->queue.push_back([this, state, function = std::forward<F>(function), ...args = std::forward<Args>(args)]() mutable {
+				if (this->cancelled()) state->fail(std::make_exception_ptr(task_cancelled()));
+				else state->fulfil([&]() -> R { return std::invoke(function, args...); });
+				state->release();
+				this->finish();
+			});
+			return task_handle<R>(state);
+		}
+		// Queued tasks of the group are dropped as threads reach them, does not wait for running tasks
+		void cancel() { this->cancelFlag->store(true, std::memory_order_relaxed); }
+		bool cancelled() const { return this->cancelFlag->load(std::memory_order_relaxed); }
+		cancellation_token token() const { return cancellation_token(this->cancelFlag); }
+		// Lets a waited on group take new tasks after a cancel, tokens handed out before stay cancelled
+		void reset()
+		{
+			if (this->pending_task_count() != 0) throw std::logic_error("Cannot reset a task_group with pending tasks.");
+			if (this->cancelled()) this->cancelFlag = std::make_shared<std::atomic<bool>>(false);
+		}
+		// Blocks until every task of this group has finished or been dropped, other tasks are run while waiting
+		// Rethrows the first exception thrown by a push_back task of the group
+		void wait()
+		{
+			this->wait_until_idle();
+			std::exception_ptr error = std::exchange(this->exception, nullptr);
+			this->failed.store(false, std::memory_order_relaxed);
+			if (error) std::rethrow_exception(error);
+		}
+		// Tasks of the group not yet finished or dropped
+		size_t pending_task_count() const { return this->outstanding.load(std::memory_order_acquire) & COUNT_MASK; }
+		task_queue& owner() const { return this->queue; }
+	};
+}
\ No newline at end of file
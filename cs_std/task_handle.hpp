@@ -0,0 +1,298 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <variant>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include "object_pool.hpp"
+#include "task.hpp"
+
+namespace cs_std
+{
+	class task_queue;
+	template<typename T> class task_handle;
+
+	namespace internal
+	{
+		// Defined in task_queue.hpp, pushes onto the queue or runs inline if there is no queue
+		void schedule_continuation(task_queue* queue, cs_std::task&& function);
+
+		struct continuation
+		{
+			cs_std::task function;
+			continuation* next = nullptr;
+			// Inline continuations run on the completing thread, used for cheap bookkeeping such as combinators
+			bool runInline = false;
+		};
+
+		// Type independent part of a handle's shared state
+		struct task_state_base
+		{
+			std::atomic<uint32_t> references;
+			std::atomic<uint32_t> completed = 0;
+			std::atomic<continuation*> continuations = nullptr;
+			std::exception_ptr exception;
+			task_queue* queue;
+			void (*destroy)(task_state_base*);
+
+			task_state_base(task_queue* queue, uint32_t references, void (*destroy)(task_state_base*)) : references(references), queue(queue), destroy(destroy) {}
+
+			static continuation* closed() { return reinterpret_cast<continuation*>(uintptr_t(1)); }
+			void acquire() { this->references.fetch_add(1, std::memory_order_relaxed); }
+			void release() { if (this->references.fetch_sub(1, std::memory_order_acq_rel) == 1) this->destroy(this); }
+			bool ready() const { return this->completed.load(std::memory_order_acquire) != 0; }
+			void wait() const { while (this->completed.load(std::memory_order_acquire) == 0) this->completed.wait(0, std::memory_order_acquire); }
+			// Runs or schedules the continuation immediately if the state has already completed
+			void add_continuation(cs_std::task&& function, bool runInline)
+			{
+				continuation* node = object_pool<continuation>::create(std::move(function), nullptr, runInline);
+				continuation* head = this->continuations.load(std::memory_order_acquire);
+				while (head != closed())
+				{
+					node->next = head;
+					if (this->continuations.compare_exchange_weak(head, node, std::memory_order_acq_rel, std::memory_order_acquire)) return;
+				}
+				this->dispatch(node);
+			}
+			void dispatch(continuation* node)
+			{
+				if (node->runInline) node->function();
+				else schedule_continuation(this->queue, std::move(node->function));
+				object_pool<continuation>::destroy(node);
+			}
+			// Publishes the result, wakes blocking waiters and releases continuations onto the queue
+			void complete()
+			{
+				this->completed.store(1, std::memory_order_release);
+				this->completed.notify_all();
+				continuation* node = this->continuations.exchange(closed(), std::memory_order_acq_rel);
+				while (node != nullptr)
+				{
+					continuation* next = node->next;
+					this->dispatch(node);
+					node = next;
+				}
+			}
+			void fail(std::exception_ptr error)
+			{
+				this->exception = error;
+				this->complete();
+			}
+		};
+
+		template<typename T>
+		struct task_state : task_state_base
+		{
+			using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+			std::optional<value_type> value;
+
+			task_state(task_queue* queue, uint32_t references) : task_state_base(queue, references, [](task_state_base* state) { object_pool<task_state<T>>::destroy(static_cast<task_state<T>*>(state)); }) {}
+			static task_state<T>* create(task_queue* queue, uint32_t references) { return object_pool<task_state<T>>::create(queue, references); }
+			// Stores the result of the producer, or the exception it threw, then completes
+			template<typename F>
+			void fulfil(F&& producer)
+			{
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+					{
+						producer();
+						this->value.emplace();
+					}
+					else this->value.emplace(producer());
+				}
+				catch (...)
+				{
+					this->exception = std::current_exception();
+				}
+				this->complete();
+			}
+		};
+
+		template<typename T, typename F>
+		struct continuation_result { using type = std::invoke_result_t<F&, const T&>; };
+		template<typename F>
+		struct continuation_result<void, F> { using type = std::invoke_result_t<F&>; };
+	}
+
+	/// <summary>
+	/// Lightweight reference counted handle to the result of a task submitted to a task_queue
+	/// Shared state is pooled, copying a handle only touches a reference count
+	/// </summary>
+	template<typename T>
+	class task_handle
+	{
+	private:
+		internal::task_state<T>* state;
+
+	public:
+		task_handle() : state(nullptr) {}
+		// Takes ownership of one reference to the shared state
+		explicit task_handle(internal::task_state<T>* state) : state(state) {}
+		~task_handle() { if (this->state != nullptr) this->state->release(); }
+		task_handle(const task_handle<T>& other) : state(other.state) { if (this->state != nullptr) this->state->acquire(); }
+		task_handle<T>& operator=(const task_handle<T>& other)
+		{
+			if (this != &other)
+			{
+				if (other.state != nullptr) other.state->acquire();
+				if (this->state != nullptr) this->state->release();
+				this->state = other.state;
+			}
+			return *this;
+		}
+		task_handle(task_handle<T>&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+		task_handle<T>& operator=(task_handle<T>&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (this->state != nullptr) this->state->release();
+				this->state = std::exchange(other.state, nullptr);
+			}
+			return *this;
+		}
+		bool valid() const { return this->state != nullptr; }
+		internal::task_state<T>* shared_state() const { return this->state; }
+		// True once the task has finished, either with a value or an exception
+		bool ready() const { return this->state->ready(); }
+		// Blocks calling thread until the task is finished, the thread sleeps rather than spins
+		void wait() const { this->state->wait(); }
+		// Waits for the result, rethrows the exception if the task threw
+		std::add_lvalue_reference_t<const T> get() const
+		{
+			this->wait();
+			if (this->state->exception) std::rethrow_exception(this->state->exception);
+			if constexpr (!std::is_void_v<T>) return this->state->value.value();
+		}
+		// Schedules function onto the same queue once this task is finished, the function receives the result
+		// If this task threw, function is skipped and the returned handle holds the same exception
+		template<typename F>
+		task_handle<typename internal::continuation_result<T, std::decay_t<F>>::type> then(F&& function) const
+		{
+			using R = typename internal::continuation_result<T, std::decay_t<F>>::type;
+			internal::task_state<T>* source = this->state;
+			// One reference for the returned handle, one for the continuation
+			internal::task_state<R>* next = internal::task_state<R>::create(source->queue, 2);
+			source->acquire();
+			source->add_continuation([source, next, function = std::forward<F>(function)]() mutable {
+				if (source->exception) next->fail(source->exception);
+				else next->fulfil([&]() -> R {
+					if constexpr (std::is_void_v<T>) return function();
+					else return function(*source->value);
+				});
+				source->release();
+				next->release();
+			}, false);
+			return task_handle<R>(next);
+		}
+	};
+
+	namespace internal
+	{
+		struct when_all_state
+		{
+			std::atomic<size_t> remaining;
+			std::atomic<bool> failed = false;
+			std::exception_ptr exception;
+			task_state<void>* target;
+
+			when_all_state(size_t remaining, task_state<void>* target) : remaining(remaining), target(target) {}
+			void arrive()
+			{
+				if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+				if (this->exception) this->target->fail(this->exception);
+				else this->target->fulfil([]() {});
+				this->target->release();
+				object_pool<when_all_state>::destroy(this);
+			}
+		};
+		struct when_any_state
+		{
+			std::atomic<size_t> remaining;
+			std::atomic<bool> claimed = false;
+			task_state<size_t>* target;
+
+			when_any_state(size_t remaining, task_state<size_t>* target) : remaining(remaining), target(target) {}
+			void arrive(size_t index)
+			{
+				if (!this->claimed.exchange(true, std::memory_order_acq_rel)) this->target->fulfil([index]() { return index; });
+				if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+				this->target->release();
+				object_pool<when_any_state>::destroy(this);
+			}
+		};
+
+		inline task_handle<void> when_all(task_state_base* const* sources, size_t count)
+		{
+			task_state<void>* target = task_state<void>::create(count > 0 ? sources[0]->queue : nullptr, 2);
+			// The extra arrival stops the target completing while continuations are still being attached
+			when_all_state* state = object_pool<when_all_state>::create(count + 1, target);
+			for (size_t i = 0; i < count; i++)
+			{
+				task_state_base* source = sources[i];
+				source->acquire();
+				source->add_continuation([state, source]() {
+					if (source->exception && !state->failed.exchange(true, std::memory_order_acq_rel)) state->exception = source->exception;
+					source->release();
+					state->arrive();
+				}, true);
+			}
+			state->arrive();
+			return task_handle<void>(target);
+		}
+		inline task_handle<size_t> when_any(task_state_base* const* sources, size_t count)
+		{
+			if (count == 0) throw std::invalid_argument("when_any requires at least one handle.");
+			task_state<size_t>* target = task_state<size_t>::create(sources[0]->queue, 2);
+			when_any_state* state = object_pool<when_any_state>::create(count, target);
+			for (size_t i = 0; i < count; i++)
+			{
+				task_state_base* source = sources[i];
+				source->acquire();
+				source->add_continuation([state, source, i]() {
+					source->release();
+					state->arrive(i);
+				}, true);
+			}
+			return task_handle<size_t>(target);
+		}
+		template<typename T>
+		std::vector<task_state_base*> shared_states(const std::vector<task_handle<T>>& handles)
+		{
+			std::vector<task_state_base*> sources;
+			sources.reserve(handles.size());
+			for (const auto& handle : handles) sources.push_back(handle.shared_state());
+			return sources;
+		}
+	}
+
+	// Completes once every handle has completed, holds the first exception thrown by any of them
+	template<typename... Ts>
+	task_handle<void> when_all(const task_handle<Ts>&... handles)
+	{
+		internal::task_state_base* sources[] = { handles.shared_state()..., nullptr };
+		return internal::when_all(sources, sizeof...(Ts));
+	}
+	template<typename T>
+	task_handle<void> when_all(const std::vector<task_handle<T>>& handles)
+	{
+		auto sources = internal::shared_states(handles);
+		return internal::when_all(sources.data(), sources.size());
+	}
+	// Completes with the index of the first handle to complete
+	template<typename... Ts>
+	task_handle<size_t> when_any(const task_handle<Ts>&... handles)
+	{
+		internal::task_state_base* sources[] = { handles.shared_state()..., nullptr };
+		return internal::when_any(sources, sizeof...(Ts));
+	}
+	template<typename T>
+	task_handle<size_t> when_any(const std::vector<task_handle<T>>& handles)
+	{
+		auto sources = internal::shared_states(handles);
+		return internal::when_any(sources.data(), sources.size());
+	}
+}
\ No newline at end of file
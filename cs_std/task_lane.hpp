@@ -0,0 +1,177 @@
+#pragma once
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include "ring_buffer.hpp"
+#include "task.hpp"
+
+namespace cs_std
+{
+	// Lanes are drained from critical down to background
+	enum class task_priority : uint8_t
+	{
+		critical,
+		high,
+		normal,
+		background,
+	};
+	constexpr size_t TASK_PRIORITY_COUNT = 4;
+
+	struct task_lane_statistics
+	{
+		// Tasks currently queued in the lane
+		size_t depth;
+		// Tasks taken out of the lane since the last reset
+		uint64_t dequeued;
+		double meanWaitSeconds;
+		double maxWaitSeconds;
+		// Upper bound of the power of two bucket holding the 99th percentile wait
+		double p99WaitSeconds;
+	};
+
+	/// <summary>
+	/// A single priority lane of a task_queue
+	/// Tasks with a deadline are served earliest deadline first ahead of the lane's FIFO tasks
+	/// Records how long each task waited between being pushed and being taken
+	/// </summary>
+	class task_lane
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+	private:
+		struct queued_task
+		{
+			cs_std::task function;
+			clock::time_point enqueued;
+			clock::time_point deadline;
+
+			bool operator>(const queued_task& other) const { return this->deadline > other.deadline; }
+		};
+		static constexpr size_t HISTOGRAM_BUCKETS = 64;
+
+		mutable std::mutex mutex;
+		cs_std::ring_buffer<queued_task> fifo;
+		// Min heap on deadline
+		std::vector<queued_task> deadlines;
+		// Mirrors of the guarded state so idle checks and urgency checks do not need the lock
+		std::atomic<size_t> depth = 0;
+		std::atomic<clock::rep> earliestDeadline = clock::time_point::max().time_since_epoch().count();
+
+		std::atomic<uint64_t> dequeued = 0;
+		std::atomic<uint64_t> totalWaitNanoseconds = 0;
+		std::atomic<uint64_t> maxWaitNanoseconds = 0;
+		// Bucket i counts waits whose nanosecond count has a bit width of i
+		std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> waitHistogram = {};
+#ifdef CS_STD_TRACING
+		// Wait of the last task this thread took from any lane, picked up by the tracer when the task runs
+		inline static thread_local uint64_t lastWaitNanoseconds = 0;
+#endif
+
+		void record_wait(clock::time_point enqueued, clock::time_point now)
+		{
+			uint64_t wait = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - enqueued).count());
+#ifdef CS_STD_TRACING
+			lastWaitNanoseconds = wait;
+#endif
+			this->dequeued.fetch_add(1, std::memory_order_relaxed);
+			this->totalWaitNanoseconds.fetch_add(wait, std::memory_order_relaxed);
+			this->waitHistogram[std::min<size_t>(std::bit_width(wait), HISTOGRAM_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+			uint64_t longest = this->maxWaitNanoseconds.load(std::memory_order_relaxed);
+			while (wait > longest && !this->maxWaitNanoseconds.compare_exchange_weak(longest, wait, std::memory_order_relaxed));
+		}
+		// Requires the lock
+		cs_std::task take_deadline(clock::time_point now)
+		{
+			std::pop_heap(this->deadlines.begin(), this->deadlines.end(), std::greater<>());
+			queued_task task = std::move(this->deadlines.back());
+			this->deadlines.pop_back();
+			this->earliestDeadline.store(this->deadlines.empty() ? clock::time_point::max().time_since_epoch().count() : this->deadlines.front().deadline.time_since_epoch().count(), std::memory_order_relaxed);
+			this->depth.fetch_sub(1, std::memory_order_relaxed);
+			this->record_wait(task.enqueued, now);
+			return std::move(task.function);
+		}
+	public:
+		task_lane() = default;
+		task_lane(const task_lane&) = delete;
+		task_lane& operator=(const task_lane&) = delete;
+
+		void push(cs_std::task&& function, clock::time_point deadline = clock::time_point::max())
+		{
+			clock::time_point now = clock::now();
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (deadline == clock::time_point::max()) this->fifo.emplace(std::move(function), now, deadline);
+			else
+			{
+				this->deadlines.push_back(queued_task{ std::move(function), now, deadline });
+				std::push_heap(this->deadlines.begin(), this->deadlines.end(), std::greater<>());
+				this->earliestDeadline.store(this->deadlines.front().deadline.time_since_epoch().count(), std::memory_order_relaxed);
+			}
+			this->depth.fetch_add(1, std::memory_order_relaxed);
+		}
+		// Deadline tasks first, then FIFO order
+		std::optional<cs_std::task> try_pop()
+		{
+			if (this->empty()) return std::nullopt;
+			clock::time_point now = clock::now();
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (!this->deadlines.empty()) return this->take_deadline(now);
+			if (this->fifo.empty()) return std::nullopt;
+			queued_task& front = this->fifo.front();
+			this->record_wait(front.enqueued, now);
+			cs_std::task function = std::move(front.function);
+			this->fifo.pop();
+			this->depth.fetch_sub(1, std::memory_order_relaxed);
+			return function;
+		}
+		// Pops the earliest deadline task only if its deadline falls before cutoff
+		std::optional<cs_std::task> try_pop_due(clock::time_point cutoff)
+		{
+			if (this->earliestDeadline.load(std::memory_order_relaxed) > cutoff.time_since_epoch().count()) return std::nullopt;
+			clock::time_point now = clock::now();
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (this->deadlines.empty() || this->deadlines.front().deadline > cutoff) return std::nullopt;
+			return this->take_deadline(now);
+		}
+#ifdef CS_STD_TRACING
+		// Returns and clears the wait recorded by the calling thread's last pop, 0 if it has not popped since
+		static uint64_t take_last_wait() { return std::exchange(lastWaitNanoseconds, 0); }
+#endif
+		bool has_deadlines() const { return this->earliestDeadline.load(std::memory_order_relaxed) != clock::time_point::max().time_since_epoch().count(); }
+		size_t size() const { return this->depth.load(std::memory_order_relaxed); }
+		bool empty() const { return this->size() == 0; }
+		task_lane_statistics statistics() const
+		{
+			task_lane_statistics result{};
+			result.depth = this->size();
+			result.dequeued = this->dequeued.load(std::memory_order_relaxed);
+			if (result.dequeued == 0) return result;
+			result.meanWaitSeconds = static_cast<double>(this->totalWaitNanoseconds.load(std::memory_order_relaxed)) * 1e-9 / static_cast<double>(result.dequeued);
+			result.maxWaitSeconds = static_cast<double>(this->maxWaitNanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+
+			uint64_t counted = 0, total = 0;
+			for (const auto& bucket : this->waitHistogram) total += bucket.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+			{
+				counted += this->waitHistogram[i].load(std::memory_order_relaxed);
+				if (counted * 100 < total * 99) continue;
+				result.p99WaitSeconds = std::min(static_cast<double>(uint64_t(1) << std::min<size_t>(i, 63)) * 1e-9, result.maxWaitSeconds);
+				break;
+			}
+			return result;
+		}
+		void reset_statistics()
+		{
+			this->dequeued.store(0, std::memory_order_relaxed);
+			this->totalWaitNanoseconds.store(0, std::memory_order_relaxed);
+			this->maxWaitNanoseconds.store(0, std::memory_order_relaxed);
+			for (auto& bucket : this->waitHistogram) bucket.store(0, std::memory_order_relaxed);
+		}
+	};
+}
\ No newline at end of file
@@ -2,22 +2,439 @@
 #include <thread>
 #include <functional>
 #include <atomic>
-#include "thread_safe_queue.hpp"
+#include <memory>
+#include <coroutine>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "task_lane.hpp"
+#include "timer_wheel.hpp"
+#include "task_handle.hpp"
+#include "task.hpp"
+#include "object_pool.hpp"
+#include "work_stealing_deque.hpp"
+#include "cpu_topology.hpp"
+#include "math/random.hpp"
+#ifdef CS_STD_TRACING
+#include <string>
+#include "trace.hpp"
+#endif
 
 namespace cs_std
 {
+	enum class scheduling_mode : uint8_t
+	{
+		// All threads pop from a single shared queue
+		fifo,
+		// Each thread owns a local deque and steals from others when it runs dry
+		work_stealing,
+	};
+
+	enum class thread_affinity : uint8_t
+	{
+		// Threads are left to the OS scheduler
+		none,
+		// Each thread is pinned to a single logical CPU
+		per_core,
+		// Each thread may run on any CPU of the NUMA node it was assigned to
+		per_node,
+	};
+
+	// Bounds for a pool that grows under load and shrinks when idle
+	struct elastic_threads
+	{
+		size_t minThreads = 1;
+		size_t maxThreads = std::thread::hardware_concurrency();
+		// How long a thread above the minimum must sit idle before it is retired
+		std::chrono::steady_clock::duration retireAfter = std::chrono::seconds(1);
+		// Queued tasks per running thread, with no thread idle, before another thread is spawned
+		size_t spawnBacklog = 2;
+	};
+
 	/// <summary>
 	/// Safe multithreaded task queue designed to automatically assign tasks to threads
 	/// </summary>
 	class task_queue
 	{
 	private:
-		cs_std::thread_safe_queue<std::function<void()>> tasks;
+		struct worker
+		{
+			task_queue* owner;
+			size_t index;
+			cs_std::work_stealing_deque<cs_std::task*> tasks;
+			cs_std::math::random_engine random;
+			// Tasks taken by this worker, used to periodically favour the low lanes
+			size_t picks = 0;
+			// Index of the NUMA node this worker was placed on and the CPUs it is restricted to, empty if unrestricted
+			size_t node = 0;
+			std::vector<size_t> cpus;
+			// Elastic pools only start threads for some worker slots, the rest sit with empty deques until needed
+			std::atomic<bool> live = false;
+			std::atomic<bool> retiring = false;
+			// When the worker last ran out of work, zero while it is busy
+			std::atomic<timer_wheel::clock::rep> idleSince = 0;
+
+			worker(task_queue* owner, size_t index) : owner(owner), index(index), random(static_cast<int64_t>(index) + 1) {}
+		};
+		// Global injection lanes, one per priority, receive all tasks pushed from outside the pool
+		std::array<task_lane, TASK_PRIORITY_COUNT> lanes;
+		// One slot per possible thread, fixed while the queue is awake so stealing never sees the vector change
+		std::vector<std::unique_ptr<worker>> workers;
 		std::vector<std::jthread> threads;
 		std::atomic<bool> isRunning;
 		std::atomic<size_t> activeThreads;
+		// Tasks pushed but not yet finished, waiters block on this reaching zero
+		std::atomic<size_t> outstandingTasks;
+		// Bumped on every push, idle threads park on it until it changes
+		std::atomic<uint32_t> workSignal;
+		std::atomic<uint32_t> sleepingThreads;
+		scheduling_mode mode;
+		thread_affinity affinity;
+		cpu_topology topology;
+		// One lane per NUMA node for tasks that carry a node hint, only present when threads have an affinity
+		std::vector<std::unique_ptr<task_lane>> nodeLanes;
+		// Every n-th task a worker takes is searched for from the lowest lane up so background work is never starved
+		std::atomic<size_t> starvationInterval = 8;
+		// Deadline tasks this close to their deadline are run ahead of every lane
+		std::atomic<task_lane::clock::rep> deadlineSlack = std::chrono::duration_cast<task_lane::clock::duration>(std::chrono::milliseconds(1)).count();
+		// Delayed and periodic tasks, one idle worker at a time parks with a timeout as the timekeeper and the rest park as usual
+		timer_wheel timers;
+		std::mutex timekeeperMutex;
+		std::condition_variable timekeeperWake;
+		std::atomic<bool> timekeeperTaken = false;
+		std::atomic<bool> timekeeperParked = false;
+		std::atomic<timer_wheel::clock::rep> timekeeperDeadline = 0;
+		// Elastic pools have minThreads below maxThreads, fixed pools have them equal
+		elastic_threads limits;
+		bool elastic = false;
+		// Limits given through elastic_threads are kept as given, only a pool constructed from a thread count takes wake's override
+		bool explicitLimits = false;
+		// Guards starting and joining threads
+		std::mutex threadsMutex;
+		std::atomic<size_t> liveThreads = 0;
+		std::atomic<bool> spawning = false;
+		std::atomic<size_t> spawnCount = 0;
+		std::atomic<size_t> retireCount = 0;
+		timer_id housekeeping;
+		// Threads blocked in a helping wait, they park on helperSignal which is bumped by pushes and finished tasks while any are waiting
+		std::atomic<uint32_t> helpingThreads = 0;
+		std::atomic<uint32_t> helperSignal = 0;
+		// Tasks held up by a wait_till_finished called from a task, pool wide so tasks waiting at the same time do not wait on each other
+		std::atomic<size_t> blockedTasks = 0;
+
+		// One per task running on a thread, any thread that helps out inside a wait pushes them too, not only workers
+		struct task_frame
+		{
+			task_queue* owner;
+			task_frame* below;
+			// Already counted as blocked by a wait_till_finished further down the stack
+			bool blocked;
+		};
+
+		inline static thread_local worker* currentWorker = nullptr;
+		inline static thread_local task_frame* currentFrame = nullptr;
+
+		void execute(cs_std::task& function)
+		{
+			task_frame frame{ this, currentFrame, false };
+			currentFrame = &frame;
+			this->activeThreads++;
+#ifdef CS_STD_TRACING
+			// Taken before running since a task that helps inside a wait pops again on this thread and replaces it
+			// Tasks from a worker's local deque never sat in a lane so they carry no wait
+			uint64_t waited = task_lane::take_last_wait();
+			tracer::clock::time_point traceStart = tracer::clock::now();
+			function();
+			tracer::complete("task", traceStart, tracer::clock::now(), "wait_ns", waited);
+#else
+			function();
+#endif
+			this->activeThreads--;
+			currentFrame = frame.below;
+			if (this->outstandingTasks.fetch_sub(1, std::memory_order_seq_cst) == 1) this->outstandingTasks.notify_all();
+			if (this->helpingThreads.load(std::memory_order_seq_cst) != 0) this->wake_helpers();
+		}
+		void wake_helpers()
+		{
+			this->helperSignal.fetch_add(1);
+			this->helperSignal.notify_all();
+		}
+		// Steal from a random victim, visiting every other worker at most once
+		cs_std::task* steal(worker* self)
+		{
+			size_t count = this->workers.size();
+			size_t start = self != nullptr ? static_cast<size_t>(self->random.int64()) % count : 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				worker& victim = *this->workers[(start + i) % count];
+				if (&victim == self) continue;
+				auto stolen = victim.tasks.steal();
+				if (stolen.has_value()) return stolen.value();
+			}
+			return nullptr;
+		}
+		task_lane& node_lane(size_t node) { return this->nodeLanes.empty() ? this->lanes[static_cast<size_t>(task_priority::normal)] : *this->nodeLanes[node % this->nodeLanes.size()]; }
+		bool run_from(task_lane& lane)
+		{
+			auto function = lane.try_pop();
+			if (!function.has_value()) return false;
+			this->execute(function.value());
+			return true;
+		}
+		void execute_local(cs_std::task* function)
+		{
+			this->execute(*function);
+			object_pool<cs_std::task>::destroy(function);
+		}
+		// Runs a single task if one can be found, self is null when called from a thread outside the pool
+		// Due deadline tasks come first, then the lanes from critical down, in work stealing mode the normal lane is preceded by
+		// the local deque and followed by stealing from other threads
+		bool run_next(worker* self)
+		{
+			bool stealing = this->mode == scheduling_mode::work_stealing;
+			if (std::any_of(this->lanes.begin(), this->lanes.end(), [](const task_lane& lane) { return lane.has_deadlines(); }))
+			{
+				task_lane::clock::time_point cutoff = task_lane::clock::now() + task_lane::clock::duration(this->deadlineSlack.load(std::memory_order_relaxed));
+				for (task_lane& lane : this->lanes)
+				{
+					auto due = lane.try_pop_due(cutoff);
+					if (!due.has_value()) continue;
+					this->execute(due.value());
+					return true;
+				}
+			}
+			bool reverse = self != nullptr && ++self->picks % this->starvationInterval.load(std::memory_order_relaxed) == 0;
+			for (size_t i = 0; i < TASK_PRIORITY_COUNT; i++)
+			{
+				size_t index = reverse ? TASK_PRIORITY_COUNT - 1 - i : i;
+				bool normal = index == static_cast<size_t>(task_priority::normal);
+				if (normal && stealing && self != nullptr)
+				{
+					auto local = self->tasks.pop();
+					if (local.has_value())
+					{
+						this->execute_local(local.value());
+						return true;
+					}
+				}
+				if (normal && self != nullptr && this->run_from(this->node_lane(self->node))) return true;
+				if (this->run_from(this->lanes[index])) return true;
+				if (normal && stealing)
+				{
+					cs_std::task* stolen = this->steal(self);
+					if (stolen != nullptr)
+					{
+						this->execute_local(stolen);
+						return true;
+					}
+				}
+			}
+			// Node hinted work is only run away from its node once there is nothing else to do
+			for (auto& lane : this->nodeLanes) if (this->run_from(*lane)) return true;
+			return false;
+		}
+		void worker_loop(worker& self)
+		{
+			currentWorker = &self;
+			if (!self.cpus.empty()) set_current_thread_affinity(self.cpus);
+#ifdef CS_STD_TRACING
+			tracer::set_thread_name("worker " + std::to_string(self.index));
+#endif
+			this->spawning.store(false);
+			// Bursts are often pushed before the first spawn finishes, so each new thread checks whether another is still needed
+			if (this->elastic) this->grow_if_backlogged();
+			while (this->isRunning && !self.retiring.load(std::memory_order_relaxed))
+			{
+				// Read the signal before searching so a push that races with the search is never missed
+				uint32_t signal = this->workSignal.load();
+				if (!this->timers.empty() && this->timers.due(timer_wheel::clock::now())) this->service_timers();
+				if (this->run_next(&self))
+				{
+					if (self.idleSince.load(std::memory_order_relaxed) != 0) self.idleSince.store(0, std::memory_order_relaxed);
+					continue;
+				}
+				if (self.idleSince.load(std::memory_order_relaxed) == 0) self.idleSince.store(timer_wheel::clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+				if (!this->timers.empty() && !this->timekeeperTaken.exchange(true))
+				{
+					this->park_timekeeper(signal);
+					this->timekeeperTaken.store(false);
+					continue;
+				}
+				this->sleepingThreads.fetch_add(1);
+				if (this->isRunning) this->workSignal.wait(signal);
+				this->sleepingThreads.fetch_sub(1);
+			}
+			currentWorker = nullptr;
+			if (this->isRunning)
+			{
+				// Retired while the pool keeps going, local work goes back to the lane for the remaining threads
+				this->hand_back(self);
+				this->retireCount.fetch_add(1, std::memory_order_relaxed);
+				this->liveThreads.fetch_sub(1);
+				self.live.store(false, std::memory_order_release);
+				// Only idle threads are woken, growing from here could hand this thread's own slot to start_worker
+				this->workSignal.fetch_add(1);
+				if (this->helpingThreads.load() != 0) this->wake_helpers();
+				this->wake_idle();
+			}
+		}
+		void hand_back(worker& self)
+		{
+			while (auto func = self.tasks.pop())
+			{
+				this->lanes[static_cast<size_t>(task_priority::normal)].push(std::move(*func.value()));
+				object_pool<cs_std::task>::destroy(func.value());
+			}
+		}
+		// Caller holds threadsMutex
+		bool start_worker()
+		{
+			for (auto& slot : this->workers)
+			{
+				if (slot->live.load(std::memory_order_acquire)) continue;
+				// The slot's previous thread has already left its loop, unless it is the caller which cannot join itself
+				std::jthread& thread = this->threads[slot->index];
+				if (thread.get_id() == std::this_thread::get_id()) continue;
+				if (thread.joinable()) thread.join();
+				slot->retiring.store(false, std::memory_order_relaxed);
+				slot->idleSince.store(0, std::memory_order_relaxed);
+				slot->live.store(true, std::memory_order_relaxed);
+				this->liveThreads.fetch_add(1);
+				thread = std::jthread([this, self = slot.get()]() { this->worker_loop(*self); });
+				return true;
+			}
+			return false;
+		}
+		// Called on push when no thread is idle, spawns a thread once the backlog outgrows the running threads
+		void grow_if_backlogged()
+		{
+			size_t live = this->liveThreads.load();
+			if (live >= this->limits.maxThreads) return;
+			size_t outstanding = this->outstandingTasks.load(std::memory_order_relaxed);
+			size_t active = this->activeThreads.load(std::memory_order_relaxed);
+			if (outstanding <= active || outstanding - active <= live * this->limits.spawnBacklog) return;
+			// One spawn at a time, the next waits until the new thread is running and the backlog is measured again
+			if (this->spawning.exchange(true)) return;
+			std::unique_lock<std::mutex> lock(this->threadsMutex, std::try_to_lock);
+			if (lock.owns_lock() && this->isRunning && this->liveThreads.load() < this->limits.maxThreads && this->start_worker())
+			{
+				this->spawnCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			this->spawning.store(false);
+		}
+		// Runs periodically in elastic pools, retires threads above the minimum that have been idle for the whole retireAfter
+		void retire_idle()
+		{
+			timer_wheel::clock::rep cutoff = (timer_wheel::clock::now() - this->limits.retireAfter).time_since_epoch().count();
+			// Threads retired by an earlier pass can still be live, they are already on their way out
+			size_t live = static_cast<size_t>(std::count_if(this->workers.begin(), this->workers.end(), [](const std::unique_ptr<worker>& slot) {
+				return slot->live.load(std::memory_order_acquire) && !slot->retiring.load(std::memory_order_relaxed);
+			}));
+			bool retired = false;
+			// Highest slots first so the low slots, and the CPUs they were placed on, stay in use
+			for (size_t i = this->workers.size(); i-- > 0 && live > this->limits.minThreads;)
+			{
+				worker& candidate = *this->workers[i];
+				if (!candidate.live.load(std::memory_order_acquire) || candidate.retiring.load(std::memory_order_relaxed)) continue;
+				timer_wheel::clock::rep idle = candidate.idleSince.load(std::memory_order_relaxed);
+				if (idle == 0 || idle > cutoff) continue;
+				candidate.retiring.store(true, std::memory_order_relaxed);
+				live--;
+				retired = true;
+			}
+			if (!retired) return;
+			this->workSignal.fetch_add(1);
+			this->workSignal.notify_all();
+			this->wake_timekeeper();
+		}
+		// Wakes a sleeping thread, or the parked timekeeper when none sleeps, false if every thread is busy
+		bool wake_idle()
+		{
+			if (this->sleepingThreads.load() != 0) this->workSignal.notify_one();
+			else if (this->timekeeperParked.load()) this->wake_timekeeper();
+			else return false;
+			return true;
+		}
+		void notify_work()
+		{
+			this->workSignal.fetch_add(1);
+			if (this->helpingThreads.load() != 0) this->wake_helpers();
+			if (!this->wake_idle() && this->elastic) this->grow_if_backlogged();
+		}
+		void wake_timekeeper()
+		{
+			std::lock_guard<std::mutex> lock(this->timekeeperMutex);
+			this->timekeeperWake.notify_one();
+		}
+		void service_timers()
+		{
+			this->timers.advance(timer_wheel::clock::now(), [this](cs_std::task&& function, task_priority priority) { this->push_back(std::move(function), priority); });
+		}
+		// Sleeps until the next timer is due, new work arrives or an earlier timer is added
+		void park_timekeeper(uint32_t signal)
+		{
+			std::unique_lock<std::mutex> lock(this->timekeeperMutex);
+			timer_wheel::clock::time_point until = this->timers.next_expiry();
+			this->timekeeperDeadline.store(until.time_since_epoch().count());
+			this->timekeeperParked.store(true);
+			this->timekeeperWake.wait_until(lock, until, [&]() {
+				return !this->isRunning || this->workSignal.load() != signal || this->timers.next_expiry() < until || this->timers.empty();
+			});
+			this->timekeeperParked.store(false);
+		}
+		timer_id add_timer(timer_wheel::clock::time_point expiry, timer_wheel::clock::duration period, cs_std::task&& function, task_priority priority, bool direct = false)
+		{
+			timer_id id = this->timers.insert(expiry, period, std::move(function), priority, direct);
+			// A parked timekeeper only needs waking if it would sleep past this timer, without one an idle worker is woken to take the role
+			if (this->timekeeperParked.load())
+			{
+				if (this->timers.next_expiry().time_since_epoch().count() < this->timekeeperDeadline.load()) this->wake_timekeeper();
+			}
+			else if (!this->timekeeperTaken.load())
+			{
+				this->workSignal.fetch_add(1);
+				if (this->sleepingThreads.load() != 0) this->workSignal.notify_one();
+			}
+			return id;
+		}
 	public:
-		explicit task_queue(size_t threadOverride = std::numeric_limits<size_t>::max()) { this->wake(threadOverride); }
+		// Awaitable that resumes the awaiting coroutine on one of the queue's threads
+		struct schedule_operation
+		{
+			task_queue& queue;
+			task_priority priority;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { this->queue.push_back([handle]() { handle.resume(); }, this->priority); }
+			void await_resume() const noexcept {}
+		};
+
+		explicit task_queue(size_t threadOverride = std::numeric_limits<size_t>::max(), scheduling_mode mode = scheduling_mode::fifo, thread_affinity affinity = thread_affinity::none) : mode(mode), affinity(affinity)
+		{
+			if (this->affinity != thread_affinity::none)
+			{
+				this->topology = cpu_topology::detect();
+				for (size_t i = 0; i < this->topology.nodes.size(); i++) this->nodeLanes.emplace_back(std::make_unique<task_lane>());
+			}
+			this->wake(threadOverride);
+		}
+		// Elastic pool, starts with minThreads and spawns up to maxThreads under load, threads idle for retireAfter are retired
+		// Equal limits give a fixed pool of exactly that many threads, unlike a thread count it is not capped at the machine's cores
+		explicit task_queue(elastic_threads limits, scheduling_mode mode = scheduling_mode::fifo, thread_affinity affinity = thread_affinity::none) : mode(mode), affinity(affinity)
+		{
+			this->limits = limits;
+			this->limits.maxThreads = std::max<size_t>(this->limits.maxThreads, 1);
+			this->limits.minThreads = std::clamp<size_t>(this->limits.minThreads, 1, this->limits.maxThreads);
+			this->elastic = this->limits.minThreads < this->limits.maxThreads;
+			this->explicitLimits = true;
+			if (this->affinity != thread_affinity::none)
+			{
+				this->topology = cpu_topology::detect();
+				for (size_t i = 0; i < this->topology.nodes.size(); i++) this->nodeLanes.emplace_back(std::make_unique<task_lane>());
+			}
+			this->wake();
+		}
 		~task_queue() { this->sleep(); }
 		// Delete move
 		task_queue(task_queue&&) = delete;
@@ -29,42 +446,205 @@ namespace cs_std
 		void sleep()
 		{
 			if (!this->isRunning) return;
+			this->timers.cancel(this->housekeeping);
+			std::lock_guard<std::mutex> lock(this->threadsMutex);
 			this->isRunning = false;
-			this->tasks.unlock();
+			this->workSignal.fetch_add(1);
+			this->workSignal.notify_all();
+			this->wake_timekeeper();
 			this->threads.clear();
+			// Hand unfinished local work back to the injection queue so a later wake can pick it up
+			for (auto& worker : this->workers) this->hand_back(*worker);
+			this->workers.clear();
+			this->liveThreads = 0;
+			this->spawning = false;
 		}
 		// Threads will be awoken and begin executing tasks
 		void wake(size_t threadOverride = std::numeric_limits<size_t>::max())
 		{
+			std::lock_guard<std::mutex> lock(this->threadsMutex);
 			if (this->isRunning) return;
 			this->isRunning = true;
 
 			this->threads.clear();
-			size_t threadCount = std::min(threadOverride, static_cast<size_t>(std::thread::hardware_concurrency()));
-			for (size_t i = 0; i < threadCount; i++)
+			// An elastic pool keeps its limits, the override only applies to pools constructed from a thread count
+			if (!this->explicitLimits) this->limits.minThreads = this->limits.maxThreads = std::min(threadOverride, static_cast<size_t>(std::thread::hardware_concurrency()));
+			size_t threadCount = this->limits.maxThreads;
+			for (size_t i = 0; i < threadCount; i++) this->workers.emplace_back(std::make_unique<worker>(this, i));
+			this->threads.resize(threadCount);
+			if (this->affinity != thread_affinity::none)
 			{
-				this->threads.emplace_back([this]() {
-					while (this->isRunning)
-					{
-						auto func = tasks.pop();
-						if (func.has_value())
-						{
-							activeThreads++;
-							func.value()();
-							activeThreads--;
-						}
-						else std::this_thread::yield();
-					}
-				});
+				// Interleaved so a pool smaller than the machine still spreads over every node
+				std::vector<size_t> cpus = this->topology.interleaved_cpus();
+				for (size_t i = 0; i < threadCount && !cpus.empty(); i++)
+				{
+					size_t cpu = cpus[i % cpus.size()];
+					this->workers[i]->node = this->topology.node_of(cpu);
+					this->workers[i]->cpus = this->affinity == thread_affinity::per_core ? std::vector<size_t>{ cpu } : this->topology.nodes[this->workers[i]->node].cpus;
+				}
+			}
+			for (size_t i = 0; i < this->limits.minThreads; i++) this->start_worker();
+			if (this->elastic)
+			{
+				timer_wheel::clock::duration interval = std::max<timer_wheel::clock::duration>(this->limits.retireAfter / 4, std::chrono::milliseconds(1));
+				// Run directly by whichever thread services the timers, as a task it would count towards finished() and wait_till_finished()
+				// Growth is checked here too since a burst pushed while the only thread was still waking sees no busy pool
+				this->housekeeping = this->add_timer(timer_wheel::clock::now() + interval, interval, [this]() {
+					this->retire_idle();
+					this->grow_if_backlogged();
+				}, task_priority::background, true);
 			}
 		}
-		void push_back(const std::function<void()>& function) { this->tasks.push(function); }
-		// Blocks calling thread until all tasks are finished
-		void wait_till_finished() { while (!this->finished()) std::this_thread::yield(); }
-		bool finished() const { return this->tasks.empty() && this->activeThreads == 0; }
-		size_t thread_count() const { return this->threads.size(); }
+		// Normal priority tasks pushed from a worker in work stealing mode stay on that worker's deque, everything else goes to its lane
+		// Local tasks live in pooled nodes so neither path allocates per task in the steady state
+		void push_back(cs_std::task function, task_priority priority = task_priority::normal)
+		{
+			this->outstandingTasks.fetch_add(1, std::memory_order_relaxed);
+			if (priority == task_priority::normal && this->mode == scheduling_mode::work_stealing && currentWorker != nullptr && currentWorker->owner == this) currentWorker->tasks.push(object_pool<cs_std::task>::create(std::move(function)));
+			else this->lanes[static_cast<size_t>(priority)].push(std::move(function));
+			this->notify_work();
+		}
+		// Deadline tasks run earliest deadline first within their lane, and ahead of every lane once within the deadline slack
+		void push_back(cs_std::task function, task_priority priority, task_lane::clock::time_point deadline)
+		{
+			this->outstandingTasks.fetch_add(1, std::memory_order_relaxed);
+			this->lanes[static_cast<size_t>(priority)].push(std::move(function), deadline);
+			this->notify_work();
+		}
+		// Normal priority task that prefers to run on a thread of the given NUMA node, so it runs near the memory it touches
+		// Threads on other nodes only take it once they have nothing else to do, without an affinity this is the same as push_back
+		void push_back_to_node(cs_std::task function, size_t node)
+		{
+			this->outstandingTasks.fetch_add(1, std::memory_order_relaxed);
+			this->node_lane(node).push(std::move(function));
+			this->notify_work();
+		}
+		// Pushes the task once delay has passed, timers are serviced by the pool so no thread is dedicated to waiting
+		// Tasks count towards wait_till_finished only once they have been pushed
+		timer_id push_after(timer_wheel::clock::duration delay, cs_std::task function, task_priority priority = task_priority::normal)
+		{
+			return this->add_timer(timer_wheel::clock::now() + delay, timer_wheel::clock::duration::zero(), std::move(function), priority);
+		}
+		// Pushes the task every period starting one period from now, firings are scheduled from the previous expiry so they do not drift
+		// A slow task can overlap its next firing, missed periods are skipped rather than fired in a burst
+		timer_id push_every(timer_wheel::clock::duration period, cs_std::task function, task_priority priority = task_priority::normal)
+		{
+			return this->add_timer(timer_wheel::clock::now() + period, period, std::move(function), priority);
+		}
+		// Stops a timer from firing again, returns false if it already fired or was cancelled
+		bool cancel_timer(timer_id id) { return this->timers.cancel(id); }
+		size_t pending_timer_count() const { return this->timers.size(); }
+		// Runs function with args on the queue, the returned handle can be waited on or chained with then()
+		template<typename F, typename... Args>
+		task_handle<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>&...>> submit(F&& function, Args&&... args)
+		{
+			using R = std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>&...>;
+			// One reference for the returned handle, one for the task
+			internal::task_state<R>* state = internal::task_state<R>::create(this, 2);
+			this->push_back([state, function = std::forward<F>(function), ...args = std::forward<Args>(args)]() mutable {
+				state->fulfil([&]() -> R { return std::invoke(function, args...); });
+				state->release();
+			});
+			return task_handle<R>(state);
+		}
+		// co_await queue.schedule() moves the rest of the coroutine onto the queue
+		schedule_operation schedule(task_priority priority = task_priority::normal) { return schedule_operation{ *this, priority }; }
+		// Runs one pending task on the calling thread, returns false if there was nothing to run
+		// Lets a thread that is waiting on work it pushed help out instead of blocking
+		bool run_pending_task() { return this->run_next(currentWorker != nullptr && currentWorker->owner == this ? currentWorker : nullptr); }
+		// Runs pending tasks on the calling thread until predicate returns true, sleeping only when there is nothing to run
+		// The predicate is rechecked after every task of this queue finishes and every push, so it must be made true by one of those
+		// Safe to call from inside a task, nested parallel work keeps every thread busy instead of blocking the one waiting
+		template<typename P>
+		void wait_for(P&& predicate)
+		{
+			while (!predicate())
+			{
+				if (this->run_pending_task()) continue;
+				this->helpingThreads.fetch_add(1, std::memory_order_seq_cst);
+				uint32_t signal = this->helperSignal.load();
+				// Rechecked after registering so a task finishing in between is not missed
+				if (!predicate() && !this->run_pending_task()) this->helperSignal.wait(signal);
+				this->helpingThreads.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		// Helps run tasks until the handle's result is ready, then returns it
+		template<typename T>
+		decltype(auto) wait(const task_handle<T>& handle)
+		{
+			this->wait_for([&]() { return handle.ready(); });
+			return handle.get();
+		}
+		// Blocks calling thread until all tasks are finished, the thread sleeps rather than spins
+		// Called from a task this waits for every other task and runs pending ones meanwhile, tasks that are themselves inside
+		// such a wait, and the tasks beneath them on their thread's stack, are not waited on
+		// This holds on any thread running the queue's tasks, including one that is not a worker but helps inside a wait
+		void wait_till_finished()
+		{
+			// Tasks of this queue on the calling thread's stack that no outer wait has counted yet, they sit above the counted ones
+			bool inside = false;
+			size_t stacked = 0;
+			for (task_frame* frame = currentFrame; frame != nullptr; frame = frame->below)
+			{
+				if (frame->owner != this) continue;
+				inside = true;
+				if (!frame->blocked) stacked++;
+				frame->blocked = true;
+			}
+			if (inside)
+			{
+				this->blockedTasks.fetch_add(stacked, std::memory_order_seq_cst);
+				// More blocked tasks can satisfy another waiter without any task finishing
+				if (this->helpingThreads.load(std::memory_order_seq_cst) != 0) this->wake_helpers();
+				this->wait_for([&]() { return this->outstandingTasks.load(std::memory_order_acquire) <= this->blockedTasks.load(std::memory_order_acquire); });
+				this->blockedTasks.fetch_sub(stacked, std::memory_order_seq_cst);
+				for (task_frame* frame = currentFrame; frame != nullptr && stacked != 0; frame = frame->below)
+				{
+					if (frame->owner != this) continue;
+					frame->blocked = false;
+					stacked--;
+				}
+				return;
+			}
+			for (size_t outstanding = this->outstandingTasks.load(std::memory_order_acquire); outstanding != 0; outstanding = this->outstandingTasks.load(std::memory_order_acquire))
+			{
+				this->outstandingTasks.wait(outstanding, std::memory_order_acquire);
+			}
+		}
+		bool finished() const { return this->outstandingTasks.load(std::memory_order_acquire) == 0; }
+		// Threads currently running, in an elastic pool this moves between the limits
+		size_t thread_count() const { return this->liveThreads.load(); }
 		// Number of threads currently executing tasks
 		size_t active_thread_count() const { return this->activeThreads; }
-		size_t pending_task_count() const { return this->tasks.size(); }
+		size_t pending_task_count() const
+		{
+			size_t count = 0;
+			for (const task_lane& lane : this->lanes) count += lane.size();
+			for (const auto& lane : this->nodeLanes) count += lane->size();
+			for (const auto& worker : this->workers) count += worker->tasks.size();
+			return count;
+		}
+		scheduling_mode scheduling() const { return this->mode; }
+		thread_affinity affinity_mode() const { return this->affinity; }
+		// Number of NUMA nodes threads are spread over, 1 without an affinity
+		size_t node_count() const { return std::max<size_t>(this->nodeLanes.size(), 1); }
+		// NUMA node of the calling thread if it belongs to this queue, otherwise 0
+		size_t current_node() const { return currentWorker != nullptr && currentWorker->owner == this ? currentWorker->node : 0; }
+		// Queue depth and wait times of tasks that went through a lane, tasks kept on a worker's local deque are not included
+		task_lane_statistics lane_statistics(task_priority priority) const { return this->lanes[static_cast<size_t>(priority)].statistics(); }
+		void reset_lane_statistics() { for (task_lane& lane : this->lanes) lane.reset_statistics(); }
+		bool is_elastic() const { return this->elastic; }
+		const elastic_threads& thread_limits() const { return this->limits; }
+		// Threads an elastic pool has spawned beyond its minimum, and retired after idling, since construction
+		size_t spawn_count() const { return this->spawnCount.load(std::memory_order_relaxed); }
+		size_t retire_count() const { return this->retireCount.load(std::memory_order_relaxed); }
+		void set_starvation_interval(size_t interval) { this->starvationInterval = std::max<size_t>(interval, 1); }
+		void set_deadline_slack(task_lane::clock::duration slack) { this->deadlineSlack = slack.count(); }
 	};
+
+	inline void internal::schedule_continuation(task_queue* queue, cs_std::task&& function)
+	{
+		if (queue != nullptr) queue->push_back(std::move(function));
+		else function();
+	}
 }
\ No newline at end of file
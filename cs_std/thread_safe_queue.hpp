@@ -3,35 +3,67 @@
 #include <mutex>
 #include <condition_variable>
 #include <optional>
+#include <iterator>
+#include <algorithm>
+#include "ring_buffer.hpp"
 
 namespace cs_std
 {
-	template<typename T>
+	// Container may be any type with a std::queue like interface, such as cs_std::ring_buffer
+	template<typename T, typename Container = std::queue<T>>
 	class thread_safe_queue
 	{
 	private:
-		std::queue<T> queue;
+		Container queue;
 		mutable std::mutex mutex;
 		std::condition_variable condition;
+		// Threads blocked in pop, lets pushes skip notifying when nobody is waiting
+		size_t waiting = 0;
 		bool unlocked = false;
+
+		// Wakes up to count waiters, called after the lock is released so woken threads do not immediately block on it
+		void wake(size_t count, size_t waiters)
+		{
+			if (count >= waiters)
+			{
+				if (waiters > 0) this->condition.notify_all();
+				return;
+			}
+			for (size_t i = 0; i < count; i++) this->condition.notify_one();
+		}
 	public:
 		thread_safe_queue() = default;
 		~thread_safe_queue() = default;
-		thread_safe_queue(const thread_safe_queue<T>& other) = delete;
-		thread_safe_queue<T>& operator=(const thread_safe_queue<T>& other) = delete;
-		thread_safe_queue(thread_safe_queue<T>&& other) noexcept = delete;
-		thread_safe_queue<T>& operator=(thread_safe_queue<T>&& other) noexcept = delete;
+		thread_safe_queue(const thread_safe_queue<T, Container>& other) = delete;
+		thread_safe_queue<T, Container>& operator=(const thread_safe_queue<T, Container>& other) = delete;
+		thread_safe_queue(thread_safe_queue<T, Container>&& other) noexcept = delete;
+		thread_safe_queue<T, Container>& operator=(thread_safe_queue<T, Container>&& other) noexcept = delete;
 		void push(const T& value)
 		{
-			std::lock_guard<std::mutex> lock(this->mutex);
+			std::unique_lock<std::mutex> lock(this->mutex);
 			this->queue.push(value);
-			this->condition.notify_one();
+			size_t waiters = this->waiting;
+			lock.unlock();
+			this->wake(1, waiters);
 		}
 		void push(T&& value)
 		{
-			std::lock_guard<std::mutex> lock(this->mutex);
+			std::unique_lock<std::mutex> lock(this->mutex);
 			this->queue.push(std::move(value));
-			this->condition.notify_one();
+			size_t waiters = this->waiting;
+			lock.unlock();
+			this->wake(1, waiters);
+		}
+		// Pushes every element of [first, last) under a single lock and wakes as many waiters as there are new elements
+		template<typename InputIt>
+		void push_range(InputIt first, InputIt last)
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			size_t count = 0;
+			for (; first != last; ++first, ++count) this->queue.push(*first);
+			size_t waiters = this->waiting;
+			lock.unlock();
+			this->wake(count, waiters);
 		}
 		// Returns the front element without popping it.
 		// We return a copy to prevent data race issues
@@ -44,7 +76,9 @@ namespace cs_std
 		std::optional<T> pop()
 		{
 			std::unique_lock<std::mutex> lock(this->mutex);
+			this->waiting++;
 			this->condition.wait(lock, [this]() { return !this->queue.empty() || unlocked; });
+			this->waiting--;
 			
 			if (this->queue.empty()) return std::nullopt;
 
@@ -62,6 +96,33 @@ namespace cs_std
 			this->queue.pop();
 			return value;
 		}
+		// Moves up to max elements into out under a single lock, returns how many were popped
+		template<typename OutputIt>
+		size_t pop_bulk(OutputIt out, size_t max)
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			size_t count = std::min(max, this->queue.size());
+			for (size_t i = 0; i < count; i++)
+			{
+				*out = std::move(this->queue.front());
+				++out;
+				this->queue.pop();
+			}
+			return count;
+		}
+		// Takes every element at once by swapping the internal container out
+		Container drain_all()
+		{
+			Container drained;
+			this->drain_all(drained);
+			return drained;
+		}
+		// Swaps the internal container with destination, pass an empty container to recycle its storage between drains
+		void drain_all(Container& destination)
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			std::swap(this->queue, destination);
+		}
 		bool empty() const
 		{
 			std::lock_guard lock(this->mutex);
@@ -90,4 +151,8 @@ namespace cs_std
 			this->condition.notify_all();
 		}
 	};
+
+	// Ring buffer backed variant, does not allocate once the buffer has grown to its working size
+	template<typename T>
+	using thread_safe_ring_queue = thread_safe_queue<T, cs_std::ring_buffer<T>>;
 }
\ No newline at end of file
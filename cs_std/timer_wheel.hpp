@@ -0,0 +1,281 @@
+#pragma once
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <limits>
+#include <bit>
+#include <cstdint>
+#include "task_lane.hpp"
+#include "task.hpp"
+
+namespace cs_std
+{
+	// Identifies a pending timer, stays safe to cancel after the timer has fired
+	struct timer_id
+	{
+		uint32_t index = std::numeric_limits<uint32_t>::max();
+		uint32_t generation = 0;
+	};
+
+	/// <summary>
+	/// Hierarchical timing wheel, four levels of 256 slots each
+	/// Inserting and cancelling are O(1), advancing only visits slots that hold timers and cascades coarse levels as time reaches them
+	/// Timers are kept in pooled nodes so a steady number of timers does not allocate
+	/// </summary>
+	class timer_wheel
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+	private:
+		static constexpr size_t SLOT_BITS = 8;
+		static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+		static constexpr size_t MASK = SLOTS - 1;
+		static constexpr size_t LEVELS = 4;
+		// Timers further out than the top level covers are parked at its far end and cascade until they are in range
+		static constexpr uint64_t MAX_DELTA = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+		static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+		struct timer_node
+		{
+			cs_std::task function;
+			// Periodic timers share their function with every task they fire so cancelling never frees a running callable
+			std::shared_ptr<cs_std::task> periodic;
+			uint64_t expiry = 0;
+			uint64_t period = 0;
+			uint32_t previous = NIL;
+			uint32_t next = NIL;
+			uint32_t generation = 0;
+			uint16_t slot = 0;
+			uint8_t level = 0;
+			bool active = false;
+			// Run by the advancing thread itself instead of being passed to fire
+			bool direct = false;
+			task_priority priority = task_priority::normal;
+		};
+		struct level
+		{
+			std::array<uint32_t, SLOTS> heads;
+			std::array<uint64_t, SLOTS / 64> occupied{};
+
+			level() { this->heads.fill(NIL); }
+		};
+
+		mutable std::mutex mutex;
+		clock::time_point origin;
+		clock::duration tick;
+		// Next tick to be processed, every timer expiring before it has fired
+		uint64_t currentTick = 0;
+		std::array<level, LEVELS> levels;
+		std::vector<timer_node> nodes;
+		std::vector<uint32_t> freeNodes;
+		std::atomic<size_t> pending = 0;
+		// Earliest time advance() has work to do, read without the lock to decide whether to take it
+		std::atomic<clock::rep> nextEvent = std::numeric_limits<clock::rep>::max();
+
+		uint64_t to_tick(clock::time_point time) const
+		{
+			if (time <= this->origin) return 0;
+			// Rounded up so a timer never fires early
+			return static_cast<uint64_t>((time - this->origin + this->tick - clock::duration(1)) / this->tick);
+		}
+		clock::time_point to_time(uint64_t tick) const { return this->origin + this->tick * static_cast<clock::rep>(tick); }
+		void link(uint32_t index)
+		{
+			timer_node& node = this->nodes[index];
+			uint64_t expiry = std::max(node.expiry, this->currentTick);
+			uint64_t delta = std::min(expiry - this->currentTick, MAX_DELTA);
+			size_t levelIndex = 0;
+			while (levelIndex < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (levelIndex + 1)))) levelIndex++;
+			size_t slot = static_cast<size_t>(((this->currentTick + delta) >> (SLOT_BITS * levelIndex)) & MASK);
+			level& target = this->levels[levelIndex];
+			node.level = static_cast<uint8_t>(levelIndex);
+			node.slot = static_cast<uint16_t>(slot);
+			node.previous = NIL;
+			node.next = target.heads[slot];
+			if (node.next != NIL) this->nodes[node.next].previous = index;
+			target.heads[slot] = index;
+			target.occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+		}
+		void unlink(uint32_t index)
+		{
+			timer_node& node = this->nodes[index];
+			level& source = this->levels[node.level];
+			if (node.previous != NIL) this->nodes[node.previous].next = node.next;
+			else source.heads[node.slot] = node.next;
+			if (node.next != NIL) this->nodes[node.next].previous = node.previous;
+			if (source.heads[node.slot] == NIL) source.occupied[node.slot / 64] &= ~(uint64_t(1) << (node.slot % 64));
+		}
+		void release(uint32_t index)
+		{
+			timer_node& node = this->nodes[index];
+			node.function.reset();
+			node.periodic.reset();
+			node.active = false;
+			node.generation++;
+			this->freeNodes.push_back(index);
+			this->pending.fetch_sub(1, std::memory_order_relaxed);
+		}
+		// Takes every timer out of a slot, the slot is left empty
+		uint32_t detach(size_t levelIndex, size_t slot)
+		{
+			level& source = this->levels[levelIndex];
+			uint32_t head = source.heads[slot];
+			source.heads[slot] = NIL;
+			source.occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+			return head;
+		}
+		// Distance from start to the first occupied slot of a level, SLOTS if the level is empty
+		static size_t next_occupied(const level& source, size_t start)
+		{
+			for (size_t offset = 0; offset < SLOTS;)
+			{
+				size_t index = (start + offset) & MASK;
+				uint64_t word = source.occupied[index / 64] >> (index % 64);
+				if (word != 0) return std::min(offset + static_cast<size_t>(std::countr_zero(word)), SLOTS);
+				offset += 64 - index % 64;
+			}
+			return SLOTS;
+		}
+		// First tick at or after currentTick where a level 0 slot fires or a coarser slot cascades
+		uint64_t next_event_tick() const
+		{
+			uint64_t best = std::numeric_limits<uint64_t>::max();
+			size_t offset = next_occupied(this->levels[0], static_cast<size_t>(this->currentTick & MASK));
+			if (offset < SLOTS) best = this->currentTick + offset;
+			for (size_t levelIndex = 1; levelIndex < LEVELS; levelIndex++)
+			{
+				size_t shift = SLOT_BITS * levelIndex;
+				// First boundary not yet cascaded, a rotation that has begun already cascaded the slot it began at
+				uint64_t first = (this->currentTick + ((uint64_t(1) << shift) - 1)) >> shift;
+				offset = next_occupied(this->levels[levelIndex], static_cast<size_t>(first & MASK));
+				if (offset < SLOTS) best = std::min(best, (first + offset) << shift);
+			}
+			return best;
+		}
+		void publish_next_event()
+		{
+			uint64_t tick = this->pending.load(std::memory_order_relaxed) != 0 ? this->next_event_tick() : std::numeric_limits<uint64_t>::max();
+			this->nextEvent.store(tick == std::numeric_limits<uint64_t>::max() ? std::numeric_limits<clock::rep>::max() : this->to_time(tick).time_since_epoch().count());
+		}
+	public:
+		explicit timer_wheel(clock::duration tick = std::chrono::milliseconds(1)) : origin(clock::now()), tick(std::max(tick, clock::duration(1))) {}
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator=(const timer_wheel&) = delete;
+		// Adds a timer firing at expiry, then every period after that if period is non zero
+		// A direct timer is called by advance() under the wheel's lock, so it must be short and must not use the wheel
+		timer_id insert(clock::time_point expiry, clock::duration period, cs_std::task function, task_priority priority = task_priority::normal, bool direct = false)
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			uint32_t index;
+			if (!this->freeNodes.empty())
+			{
+				index = this->freeNodes.back();
+				this->freeNodes.pop_back();
+			}
+			else
+			{
+				index = static_cast<uint32_t>(this->nodes.size());
+				this->nodes.emplace_back();
+			}
+			timer_node& node = this->nodes[index];
+			node.expiry = this->to_tick(expiry);
+			node.priority = priority;
+			node.direct = direct;
+			node.active = true;
+			if (period > clock::duration::zero())
+			{
+				node.period = std::max<uint64_t>(static_cast<uint64_t>((period + this->tick - clock::duration(1)) / this->tick), 1);
+				node.periodic = std::make_shared<cs_std::task>(std::move(function));
+			}
+			else
+			{
+				node.period = 0;
+				node.function = std::move(function);
+			}
+			this->link(index);
+			this->pending.fetch_add(1, std::memory_order_relaxed);
+			clock::rep time = this->to_time(std::max(node.expiry, this->currentTick)).time_since_epoch().count();
+			if (time < this->nextEvent.load(std::memory_order_relaxed)) this->nextEvent.store(time);
+			return timer_id{ index, node.generation };
+		}
+		// Returns false if the timer already fired or was cancelled, a cancelled periodic timer fires no further tasks
+		bool cancel(timer_id id)
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (id.index >= this->nodes.size()) return false;
+			timer_node& node = this->nodes[id.index];
+			if (!node.active || node.generation != id.generation) return false;
+			this->unlink(id.index);
+			this->release(id.index);
+			// nextEvent is left as is, at worst the next advance finds nothing to do
+			return true;
+		}
+		// Fires every timer that has expired by now through fire(task, priority), or calls it if direct, returns how many fired
+		// Returns 0 straight away if another thread is already advancing
+		template<typename F>
+		size_t advance(clock::time_point now, F&& fire)
+		{
+			std::unique_lock<std::mutex> lock(this->mutex, std::try_to_lock);
+			if (!lock.owns_lock()) return 0;
+			// One past the last tick that has started
+			uint64_t end = now < this->origin ? 0 : static_cast<uint64_t>((now - this->origin) / this->tick) + 1;
+			size_t fired = 0;
+			while (this->currentTick < end && this->pending.load(std::memory_order_relaxed) != 0)
+			{
+				// Every slot between here and the next event is empty so the ticks in between are skipped
+				uint64_t tick = std::max(this->currentTick, std::min(this->next_event_tick(), end));
+				if (tick >= end) break;
+				this->currentTick = tick;
+				// Coarse levels cascade first so their timers can land in the finer slots about to be processed
+				for (size_t levelIndex = LEVELS - 1; levelIndex > 0; levelIndex--)
+				{
+					size_t shift = SLOT_BITS * levelIndex;
+					if ((tick & ((uint64_t(1) << shift) - 1)) != 0) continue;
+					for (uint32_t index = this->detach(levelIndex, static_cast<size_t>((tick >> shift) & MASK)); index != NIL;)
+					{
+						uint32_t next = this->nodes[index].next;
+						this->link(index);
+						index = next;
+					}
+				}
+				for (uint32_t index = this->detach(0, static_cast<size_t>(tick & MASK)); index != NIL;)
+				{
+					timer_node& node = this->nodes[index];
+					uint32_t next = node.next;
+					fired++;
+					if (node.period == 0)
+					{
+						if (node.direct) node.function();
+						else fire(std::move(node.function), node.priority);
+						this->release(index);
+					}
+					else
+					{
+						if (node.direct) (*node.periodic)();
+						else fire(cs_std::task([function = node.periodic]() { (*function)(); }), node.priority);
+						// Rescheduled from the previous expiry rather than from now so the period does not drift, missed periods are skipped
+						node.expiry += node.period;
+						if (node.expiry <= tick) node.expiry += ((tick - node.expiry) / node.period + 1) * node.period;
+						this->link(index);
+					}
+					index = next;
+				}
+				this->currentTick = tick + 1;
+			}
+			// Nothing is due before end so the wheel can move straight there
+			this->currentTick = std::max(this->currentTick, end);
+			this->publish_next_event();
+			return fired;
+		}
+		// Lock-free check for whether advance() has anything to fire
+		bool due(clock::time_point now) const { return this->pending.load(std::memory_order_relaxed) != 0 && now.time_since_epoch().count() >= this->nextEvent.load(); }
+		// Time the next timer fires or a coarse slot needs cascading, timers in the same tick share one wakeup
+		clock::time_point next_expiry() const { return clock::time_point(clock::duration(this->nextEvent.load())); }
+		size_t size() const { return this->pending.load(std::memory_order_relaxed); }
+		bool empty() const { return this->size() == 0; }
+		clock::duration resolution() const { return this->tick; }
+	};
+}
\ No newline at end of file
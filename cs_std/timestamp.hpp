@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
 
 namespace cs_std
 {
@@ -16,6 +17,8 @@ namespace cs_std
 			std::chrono::duration<T> duration = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start);
 			return duration.count();
 		}
+		uint64_t nanoseconds() const { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count()); }
+		std::chrono::high_resolution_clock::time_point start_time() const { return start; }
 	};
 }
 
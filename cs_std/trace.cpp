@@ -0,0 +1,214 @@
+#include "trace.hpp"
+#include <array>
+#include <fstream>
+#include <utility>
+#include <string_view>
+#include <unordered_map>
+
+namespace cs_std
+{
+	namespace
+	{
+		void write_json_string(std::ostream& stream, std::string_view text)
+		{
+			stream << '"';
+			for (char character : text)
+			{
+				switch (character)
+				{
+				case '"': stream << "\\\""; break;
+				case '\\': stream << "\\\\"; break;
+				case '\n': stream << "\\n"; break;
+				case '\t': stream << "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(character) < 0x20) stream << "\\u00" << "0123456789abcdef"[character >> 4] << "0123456789abcdef"[character & 0xF];
+					else stream << character;
+				}
+			}
+			stream << '"';
+		}
+		// Nanoseconds as microseconds, the unit Chrome traces use
+		void write_microseconds(std::ostream& stream, uint64_t nanoseconds)
+		{
+			uint64_t fraction = nanoseconds % 1000;
+			stream << nanoseconds / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+		}
+		template<typename T>
+		void write_value(std::ostream& stream, T value)
+		{
+			std::array<char, sizeof(T)> bytes;
+			for (size_t i = 0; i < sizeof(T); i++) bytes[i] = static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF);
+			stream.write(bytes.data(), bytes.size());
+		}
+		void write_short_string(std::ostream& stream, std::string_view text)
+		{
+			text = text.substr(0, UINT16_MAX);
+			write_value(stream, static_cast<uint16_t>(text.size()));
+			stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+		}
+		// Owned by the thread, trivially destructible so trace scopes in destructors that run after the thread's own still work
+		struct buffer_owner
+		{
+			void* buffer = nullptr;
+			std::atomic<bool>* orphaned = nullptr;
+		};
+		thread_local buffer_owner localOwner;
+		// Flags the thread's buffer for freeing when the thread exits, the next collect may free it so the cached pointer is cleared
+		// Events recorded after that register a new buffer, which is only reclaimed with the process
+		struct buffer_owner_release
+		{
+			~buffer_owner_release()
+			{
+				localOwner.buffer = nullptr;
+				if (localOwner.orphaned != nullptr) std::exchange(localOwner.orphaned, nullptr)->store(true, std::memory_order_release);
+			}
+		};
+		thread_local buffer_owner_release localRelease;
+	}
+
+	std::atomic<bool> tracer::isEnabled = true;
+	const tracer::clock::time_point tracer::origin = tracer::clock::now();
+	std::mutex tracer::registryMutex;
+	std::vector<std::unique_ptr<tracer::thread_buffer>> tracer::buffers;
+	std::vector<tracer::collected_event> tracer::collected;
+	std::vector<std::string> tracer::threadNames;
+	uint64_t tracer::droppedByExitedThreads = 0;
+
+	tracer::thread_buffer& tracer::local()
+	{
+		if (localOwner.buffer != nullptr) return *static_cast<thread_buffer*>(localOwner.buffer);
+		// Naming it constructs the release for this thread
+		static_cast<void>(localRelease);
+		std::lock_guard<std::mutex> lock(registryMutex);
+		std::unique_ptr<thread_buffer> buffer = std::make_unique<thread_buffer>();
+		buffer->id = static_cast<uint32_t>(threadNames.size());
+		buffer->name = "thread " + std::to_string(buffer->id);
+		threadNames.push_back(buffer->name);
+		localOwner.buffer = buffer.get();
+		localOwner.orphaned = &buffer->orphaned;
+		buffers.push_back(std::move(buffer));
+		return *static_cast<thread_buffer*>(localOwner.buffer);
+	}
+	void tracer::set_thread_name(std::string name)
+	{
+		thread_buffer& buffer = local();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadNames[buffer.id] = name;
+		buffer.name = std::move(name);
+	}
+	size_t tracer::collect()
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		size_t before = collected.size();
+		std::array<trace_event, 256> chunk;
+		for (size_t i = 0; i < buffers.size();)
+		{
+			thread_buffer& buffer = *buffers[i];
+			// Checked before draining so every event the thread pushed before exiting is drained below
+			bool orphaned = buffer.orphaned.load(std::memory_order_acquire);
+			for (size_t count = buffer.events.pop_n(chunk); count != 0; count = buffer.events.pop_n(chunk))
+			{
+				for (size_t j = 0; j < count; j++) collected.push_back(collected_event{ buffer.id, chunk[j] });
+			}
+			if (!orphaned)
+			{
+				i++;
+				continue;
+			}
+			droppedByExitedThreads += buffer.dropped.load(std::memory_order_relaxed);
+			buffers.erase(buffers.begin() + static_cast<std::ptrdiff_t>(i));
+		}
+		return collected.size() - before;
+	}
+	void tracer::write_chrome_json(std::ostream& stream)
+	{
+		collect();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		for (size_t i = 0; i < threadNames.size(); i++)
+		{
+			stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+			write_json_string(stream, threadNames[i]);
+			stream << "}},\n";
+		}
+		for (size_t i = 0; i < collected.size(); i++)
+		{
+			const trace_event& event = collected[i].event;
+			stream << "{\"name\":";
+			write_json_string(stream, event.name);
+			stream << ",\"pid\":1,\"tid\":" << collected[i].thread << ",\"ts\":";
+			write_microseconds(stream, event.start);
+			if (event.type == trace_event_type::complete)
+			{
+				stream << ",\"ph\":\"X\",\"dur\":";
+				write_microseconds(stream, event.duration);
+			}
+			else stream << ",\"ph\":\"i\",\"s\":\"t\"";
+			if (event.argumentName != nullptr)
+			{
+				stream << ",\"args\":{";
+				write_json_string(stream, event.argumentName);
+				stream << ':' << event.argument << '}';
+			}
+			stream << (i + 1 < collected.size() ? "},\n" : "}\n");
+		}
+		stream << "]}\n";
+	}
+	void tracer::write_binary(std::ostream& stream)
+	{
+		collect();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		std::unordered_map<std::string_view, uint32_t> nameIndices;
+		std::vector<std::string_view> names;
+		for (const collected_event& entry : collected)
+		{
+			if (nameIndices.emplace(entry.event.name, static_cast<uint32_t>(names.size())).second) names.push_back(entry.event.name);
+			if (entry.event.argumentName != nullptr && nameIndices.emplace(entry.event.argumentName, static_cast<uint32_t>(names.size())).second) names.push_back(entry.event.argumentName);
+		}
+		stream.write("CSTRACE1", 8);
+		write_value(stream, static_cast<uint32_t>(threadNames.size()));
+		for (const std::string& name : threadNames) write_short_string(stream, name);
+		write_value(stream, static_cast<uint32_t>(names.size()));
+		for (std::string_view name : names) write_short_string(stream, name);
+		write_value(stream, static_cast<uint64_t>(collected.size()));
+		for (const collected_event& entry : collected)
+		{
+			write_value(stream, entry.thread);
+			write_value(stream, nameIndices[entry.event.name]);
+			write_value(stream, entry.event.argumentName != nullptr ? nameIndices[entry.event.argumentName] : UINT32_MAX);
+			write_value(stream, static_cast<uint8_t>(entry.event.type));
+			write_value(stream, entry.event.start);
+			write_value(stream, entry.event.duration);
+			write_value(stream, entry.event.argument);
+		}
+	}
+	bool tracer::save_chrome_json(const std::filesystem::path& filePath)
+	{
+		std::ofstream stream(filePath, std::ios::binary);
+		if (!stream) return false;
+		write_chrome_json(stream);
+		return static_cast<bool>(stream);
+	}
+	bool tracer::save_binary(const std::filesystem::path& filePath)
+	{
+		std::ofstream stream(filePath, std::ios::binary);
+		if (!stream) return false;
+		write_binary(stream);
+		return static_cast<bool>(stream);
+	}
+	void tracer::clear()
+	{
+		collect();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		collected.clear();
+		for (auto& buffer : buffers) buffer->dropped.store(0, std::memory_order_relaxed);
+		droppedByExitedThreads = 0;
+	}
+	uint64_t tracer::dropped_events()
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		uint64_t dropped = droppedByExitedThreads;
+		for (const auto& buffer : buffers) dropped += buffer->dropped.load(std::memory_order_relaxed);
+		return dropped;
+	}
+}
\ No newline at end of file
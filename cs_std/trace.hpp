@@ -0,0 +1,144 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include <filesystem>
+#include "spsc_queue.hpp"
+#include "timestamp.hpp"
+
+// Instrumentation is only compiled in when CS_STD_TRACING is defined, define it for every translation unit or none
+// Without it the macros below expand to nothing and task_queue records nothing, the tracer itself stays available for export
+#ifdef CS_STD_TRACING
+#define CS_TRACE_CONCAT_INNER(a, b) a##b
+#define CS_TRACE_CONCAT(a, b) CS_TRACE_CONCAT_INNER(a, b)
+#define CS_TRACE_SCOPE(name) cs_std::trace_scope CS_TRACE_CONCAT(csTraceScope, __LINE__)(name)
+#define CS_TRACE_INSTANT(name) cs_std::tracer::instant(name)
+#define CS_TRACE_THREAD_NAME(name) cs_std::tracer::set_thread_name(name)
+#else
+#define CS_TRACE_SCOPE(name) ((void)0)
+#define CS_TRACE_INSTANT(name) ((void)0)
+#define CS_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+namespace cs_std
+{
+	enum class trace_event_type : uint8_t
+	{
+		// Span with a start and a duration
+		complete,
+		// Single point in time
+		instant,
+	};
+
+	struct trace_event
+	{
+		// Must outlive the trace, in practice a string literal
+		const char* name;
+		// Nanoseconds since the tracer started
+		uint64_t start;
+		uint64_t duration;
+		// Optional value shown with the event under argumentName, task_queue tasks record the nanoseconds they waited in their lane
+		const char* argumentName;
+		uint64_t argument;
+		trace_event_type type;
+	};
+
+	/// <summary>
+	/// Process wide event recorder
+	/// Each thread writes into its own wait-free ring so recording never takes a lock, collect() drains every ring into one store
+	/// A ring that fills up before it is collected drops new events and counts them
+	/// </summary>
+	class tracer
+	{
+	public:
+		typedef std::chrono::high_resolution_clock clock;
+		static constexpr size_t THREAD_BUFFER_EVENTS = size_t(1) << 14;
+	private:
+		struct thread_buffer
+		{
+			spsc_queue<trace_event, THREAD_BUFFER_EVENTS> events;
+			uint32_t id;
+			std::string name;
+			std::atomic<uint64_t> dropped = 0;
+			// Set once the owning thread exits, the buffer is freed on the next collect
+			std::atomic<bool> orphaned = false;
+		};
+		struct collected_event
+		{
+			uint32_t thread;
+			trace_event event;
+		};
+
+		static std::atomic<bool> isEnabled;
+		static const clock::time_point origin;
+		// Guards the buffer list and the collected events, and makes the collecting thread the only consumer of every ring
+		static std::mutex registryMutex;
+		static std::vector<std::unique_ptr<thread_buffer>> buffers;
+		static std::vector<collected_event> collected;
+		// Names of every thread that has recorded, kept after its buffer is freed
+		static std::vector<std::string> threadNames;
+		static uint64_t droppedByExitedThreads;
+
+		static thread_buffer& local();
+		static uint64_t since_origin(clock::time_point time) { return time > origin ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count()) : 0; }
+	public:
+		static void record(const trace_event& event)
+		{
+			if (!isEnabled.load(std::memory_order_relaxed)) return;
+			thread_buffer& buffer = local();
+			if (!buffer.events.try_push(event)) buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		static void complete(const char* name, clock::time_point start, clock::time_point end)
+		{
+			uint64_t begin = since_origin(start);
+			record(trace_event{ name, begin, since_origin(end) - begin, nullptr, 0, trace_event_type::complete });
+		}
+		static void complete(const char* name, clock::time_point start, clock::time_point end, const char* argumentName, uint64_t argument)
+		{
+			uint64_t begin = since_origin(start);
+			record(trace_event{ name, begin, since_origin(end) - begin, argumentName, argument, trace_event_type::complete });
+		}
+		static void instant(const char* name) { record(trace_event{ name, since_origin(clock::now()), 0, nullptr, 0, trace_event_type::instant }); }
+		static void instant(const char* name, const char* argumentName, uint64_t argument) { record(trace_event{ name, since_origin(clock::now()), 0, argumentName, argument, trace_event_type::instant }); }
+		// Name shown for the calling thread, defaults to "thread n"
+		static void set_thread_name(std::string name);
+		// Recording can be paused at runtime, each event then costs one relaxed load
+		static void enable(bool enabled) { isEnabled.store(enabled, std::memory_order_relaxed); }
+		static bool enabled() { return isEnabled.load(std::memory_order_relaxed); }
+
+		// Moves every event recorded so far out of the thread rings, returns how many were moved
+		// Long traces should collect periodically so the rings do not fill up
+		static size_t collect();
+		// Collects, then writes every collected event in Chrome's trace event format (chrome://tracing, Perfetto)
+		static void write_chrome_json(std::ostream& stream);
+		// Collects, then writes every collected event in a compact little endian binary layout:
+		// "CSTRACE1", u32 thread count, per thread {u16 length, name bytes}, u32 name count, per name {u16 length, bytes},
+		// u64 event count, per event {u32 thread, u32 name index, u32 argument name index or 0xFFFFFFFF, u8 type, u64 start ns, u64 duration ns, u64 argument}
+		static void write_binary(std::ostream& stream);
+		static bool save_chrome_json(const std::filesystem::path& filePath);
+		static bool save_binary(const std::filesystem::path& filePath);
+		// Discards collected events and anything still in the rings
+		static void clear();
+		static uint64_t dropped_events();
+	};
+
+	/// <summary>
+	/// Records the time between construction and destruction as a complete event
+	/// </summary>
+	class trace_scope
+	{
+	private:
+		const char* name;
+		timestamp time;
+	public:
+		explicit trace_scope(const char* name) : name(name) {}
+		~trace_scope() { tracer::complete(this->name, this->time.start_time(), tracer::clock::now()); }
+		trace_scope(const trace_scope&) = delete;
+		trace_scope& operator=(const trace_scope&) = delete;
+	};
+}
\ No newline at end of file
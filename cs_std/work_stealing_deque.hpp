@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <type_traits>
+
+namespace cs_std
+{
+	/// <summary>
+	/// Lock-free Chase-Lev work stealing deque
+	/// The owning thread pushes and pops from the bottom, any other thread may steal from the top
+	/// </summary>
+	template<typename T>
+	class work_stealing_deque
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "work_stealing_deque elements must be trivially copyable, store pointers or handles instead");
+	private:
+		struct ring
+		{
+			int64_t capacity;
+			std::unique_ptr<std::atomic<T>[]> items;
+
+			explicit ring(int64_t capacity) : capacity(capacity), items(std::make_unique<std::atomic<T>[]>(capacity)) {}
+			T load(int64_t index) const { return this->items[index & (this->capacity - 1)].load(std::memory_order_relaxed); }
+			void store(int64_t index, T value) { this->items[index & (this->capacity - 1)].store(value, std::memory_order_relaxed); }
+		};
+		alignas(64) std::atomic<int64_t> top;
+		alignas(64) std::atomic<int64_t> bottom;
+		std::atomic<ring*> buffer;
+		// Only the owner grows the deque, retired rings are kept alive as thieves may still be reading them
+		std::vector<std::unique_ptr<ring>> rings;
+
+		ring* grow(ring* old, int64_t top, int64_t bottom)
+		{
+			ring* larger = this->rings.emplace_back(std::make_unique<ring>(old->capacity * 2)).get();
+			for (int64_t i = top; i < bottom; i++) larger->store(i, old->load(i));
+			this->buffer.store(larger, std::memory_order_release);
+			return larger;
+		}
+	public:
+		// Capacity must be a power of two
+		explicit work_stealing_deque(int64_t capacity = 256) : top(0), bottom(0)
+		{
+			this->buffer.store(this->rings.emplace_back(std::make_unique<ring>(capacity)).get(), std::memory_order_relaxed);
+		}
+		~work_stealing_deque() = default;
+		work_stealing_deque(const work_stealing_deque<T>& other) = delete;
+		work_stealing_deque<T>& operator=(const work_stealing_deque<T>& other) = delete;
+		work_stealing_deque(work_stealing_deque<T>&& other) noexcept = delete;
+		work_stealing_deque<T>& operator=(work_stealing_deque<T>&& other) noexcept = delete;
+		// Owner only, pushes an element to the bottom of the deque
+		void push(T value)
+		{
+			int64_t b = this->bottom.load(std::memory_order_relaxed);
+			int64_t t = this->top.load(std::memory_order_acquire);
+			ring* r = this->buffer.load(std::memory_order_relaxed);
+			if (b - t > r->capacity - 1) r = this->grow(r, t, b);
+			r->store(b, value);
+			std::atomic_thread_fence(std::memory_order_release);
+			this->bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		// Owner only, pops the most recently pushed element
+		std::optional<T> pop()
+		{
+			int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+			ring* r = this->buffer.load(std::memory_order_relaxed);
+			this->bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = this->top.load(std::memory_order_relaxed);
+			if (t > b)
+			{
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+				return std::nullopt;
+			}
+			T value = r->load(b);
+			if (t == b)
+			{
+				// Last element, race against thieves for it
+				bool won = this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+				if (!won) return std::nullopt;
+			}
+			return value;
+		}
+		// Any thread, steals the oldest element, returns a nullopt if empty or another thread won the race
+		std::optional<T> steal()
+		{
+			int64_t t = this->top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = this->bottom.load(std::memory_order_acquire);
+			if (t >= b) return std::nullopt;
+
+			ring* r = this->buffer.load(std::memory_order_acquire);
+			T value = r->load(t);
+			if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return std::nullopt;
+			return value;
+		}
+		// Approximate size, may be stale by the time it returns
+		size_t size() const
+		{
+			int64_t b = this->bottom.load(std::memory_order_relaxed);
+			int64_t t = this->top.load(std::memory_order_relaxed);
+			return b > t ? static_cast<size_t>(b - t) : 0;
+		}
+		bool empty() const { return this->size() == 0; }
+	};
+}
\ No newline at end of file
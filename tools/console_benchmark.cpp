@@ -0,0 +1,60 @@
+// Cost per line of cs_std::console logging to a file sink with thread safety on, off, and in async mode
+// Usage: console_benchmark [lines] [log file], lines are split evenly over 1 and 4 logging threads
+// Build alongside cs_std, for example: g++ -std=c++20 -O2 -I../cs_std console_benchmark.cpp ../cs_std/console.cpp ../cs_std/log_sink.cpp -pthread -o console_benchmark
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "console.hpp"
+#include "timestamp.hpp"
+
+namespace
+{
+	enum class mode
+	{
+		locked,
+		merged,
+		async,
+	};
+	constexpr const char* MODE_NAMES[] = { "thread safety on", "thread safety off", "async" };
+
+	// Prints the time spent in the log calls and the time until a flush returns, both per line
+	void measure(mode logging, size_t threadCount, size_t lines)
+	{
+		cs_std::console::thread_safety(logging == mode::locked);
+		cs_std::console::async(logging == mode::async);
+		size_t perThread = std::max<size_t>(lines / threadCount, 1);
+		std::vector<std::jthread> threads;
+		cs_std::timestamp time;
+		for (size_t t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([t, perThread]() {
+				for (size_t i = 0; i < perThread; i++) cs_std::console::log("thread ", t, " value ", i, " ratio ", static_cast<double>(i) * 0.5);
+			});
+		}
+		threads.clear();
+		double calls = time.elapsed();
+		cs_std::console::flush();
+		double total = time.elapsed();
+		double count = static_cast<double>(perThread * threadCount);
+		std::printf("%-20s%8zu%14.1f ns/line%15.1f ns/line\n", MODE_NAMES[static_cast<size_t>(logging)], threadCount, calls * 1e9 / count, total * 1e9 / count);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const char* path = argc > 2 ? argv[2] : "console_benchmark.log";
+	cs_std::console::detach(cs_std::console::standard_output());
+	cs_std::console::attach(std::make_shared<cs_std::file_sink>(path, false));
+	std::printf("%zu lines to %s, %u hardware threads\n", lines, path, std::thread::hardware_concurrency());
+	std::printf("%-20s%8s%22s%23s\n", "mode", "threads", "in calls", "until flushed");
+	for (size_t threadCount : { 1, 4 })
+	{
+		for (mode logging : { mode::locked, mode::merged, mode::async }) measure(logging, threadCount, lines);
+	}
+	cs_std::console::async(false);
+	cs_std::console::thread_safety(true);
+	return 0;
+}
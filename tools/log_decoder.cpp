@@ -0,0 +1,152 @@
+// Turns a binary log written by cs_std::console::open_binary_log back into text or JSON
+// Usage: log_decoder [--json] <log file>, output goes to stdout
+// Build alongside cs_std, for example: g++ -std=c++20 -I../cs_std log_decoder.cpp -o log_decoder
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include "log_record.hpp"
+
+namespace
+{
+	// Reads values from the file's bytes, fails instead of reading past the end
+	class reader
+	{
+	private:
+		const std::vector<std::byte>& bytes;
+		size_t position = 0;
+	public:
+		explicit reader(const std::vector<std::byte>& bytes) : bytes(bytes) {}
+		bool done() const { return this->position == this->bytes.size(); }
+		bool read(void* out, size_t size)
+		{
+			if (this->bytes.size() - this->position < size) return false;
+			std::memcpy(out, this->bytes.data() + this->position, size);
+			this->position += size;
+			return true;
+		}
+		const std::byte* skip(size_t size)
+		{
+			if (this->bytes.size() - this->position < size) return nullptr;
+			const std::byte* data = this->bytes.data() + this->position;
+			this->position += size;
+			return data;
+		}
+	};
+
+	// Size of every encoded argument, so a record can be checked before it is formatted
+	bool fits(const std::vector<cs_std::log_arg_type>& signature, const std::byte* data, size_t size)
+	{
+		for (cs_std::log_arg_type type : signature)
+		{
+			size_t argumentSize;
+			switch (type)
+			{
+			case cs_std::log_arg_type::boolean:
+			case cs_std::log_arg_type::character: argumentSize = 1; break;
+			case cs_std::log_arg_type::int16:
+			case cs_std::log_arg_type::uint16: argumentSize = 2; break;
+			case cs_std::log_arg_type::int32:
+			case cs_std::log_arg_type::uint32:
+			case cs_std::log_arg_type::float32: argumentSize = 4; break;
+			case cs_std::log_arg_type::string:
+			{
+				uint32_t length;
+				if (size < sizeof(length)) return false;
+				std::memcpy(&length, data, sizeof(length));
+				argumentSize = sizeof(length) + length;
+				break;
+			}
+			default: argumentSize = 8;
+			}
+			if (size < argumentSize) return false;
+			data += argumentSize;
+			size -= argumentSize;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool json = false;
+	const char* filePath = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string_view(argv[i]) == "--json") json = true;
+		else filePath = argv[i];
+	}
+	if (filePath == nullptr)
+	{
+		std::cerr << "Usage: log_decoder [--json] <log file>\n";
+		return 2;
+	}
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Cannot open " << filePath << "\n";
+		return 1;
+	}
+	std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::vector<std::byte> bytes(contents.size());
+	std::memcpy(bytes.data(), contents.data(), contents.size());
+
+	reader input(bytes);
+	char magic[sizeof(cs_std::LOG_FILE_MAGIC)];
+	if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, cs_std::LOG_FILE_MAGIC, sizeof(magic)) != 0)
+	{
+		std::cerr << filePath << " is not a cs_std binary log\n";
+		return 1;
+	}
+	std::unordered_map<uint32_t, std::vector<cs_std::log_arg_type>> signatures;
+	uint64_t origin = 0;
+	std::string out;
+	while (!input.done())
+	{
+		cs_std::log_chunk chunk;
+		if (!input.read(&chunk, sizeof(chunk))) break;
+		if (chunk == cs_std::log_chunk::signature)
+		{
+			uint32_t id;
+			uint16_t count;
+			if (!input.read(&id, sizeof(id)) || !input.read(&count, sizeof(count))) break;
+			std::vector<cs_std::log_arg_type> signature(count);
+			if (!input.read(signature.data(), count)) break;
+			signatures[id] = std::move(signature);
+			continue;
+		}
+		if (chunk == cs_std::log_chunk::origin)
+		{
+			if (!input.read(&origin, sizeof(origin))) break;
+			continue;
+		}
+		uint32_t size;
+		const std::byte* record;
+		if (chunk != cs_std::log_chunk::record || !input.read(&size, sizeof(size)) || size < sizeof(cs_std::log_record_header) || (record = input.skip(size)) == nullptr)
+		{
+			std::cerr << "Corrupt or truncated chunk, stopping\n";
+			break;
+		}
+		cs_std::log_record_header header;
+		std::memcpy(&header, record, sizeof(header));
+		auto signature = signatures.find(header.signature);
+		if (signature == signatures.end() || !fits(signature->second, record + sizeof(header), size - sizeof(header)))
+		{
+			std::cerr << "Record with an unknown or mismatched signature, skipping\n";
+			continue;
+		}
+		if (json) cs_std::internal::log_append_json(out, header, signature->second, record + sizeof(header));
+		else cs_std::internal::log_append_text(out, header, signature->second, record + sizeof(header), origin);
+		if (out.size() >= (size_t(64) << 10))
+		{
+			std::fwrite(out.data(), 1, out.size(), stdout);
+			out.clear();
+		}
+	}
+	std::fwrite(out.data(), 1, out.size(), stdout);
+	return 0;
+}
@@ -0,0 +1,73 @@
+// Producer/consumer throughput of cs_std::mpmc_queue against the mutex based cs_std::thread_safe_queue
+// Usage: mpmc_queue_benchmark [items], items are split evenly over 1, 4, 16 and 64 producer/consumer pairs
+// Build alongside cs_std, for example: g++ -std=c++20 -O2 -I../cs_std mpmc_queue_benchmark.cpp -pthread -o mpmc_queue_benchmark
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "timestamp.hpp"
+#include "mpmc_queue.hpp"
+#include "thread_safe_queue.hpp"
+
+namespace
+{
+	constexpr size_t CAPACITY = 1024;
+
+	// Every producer pushes perThread values and every consumer pops as many, so no sentinel is needed to stop them
+	// Threads are started first and released together so thread creation is not timed, returns millions of items per second
+	template<typename Push, typename Pop>
+	double measure(size_t pairs, size_t perThread, Push&& push, Pop&& pop)
+	{
+		std::atomic<bool> start = false;
+		std::atomic<size_t> ready = 0;
+		std::atomic<long> checksum = 0;
+		std::vector<std::jthread> threads;
+		for (size_t i = 0; i < pairs; i++)
+		{
+			threads.emplace_back([&]() {
+				ready++;
+				while (!start.load()) std::this_thread::yield();
+				for (size_t value = 0; value < perThread; value++) push(static_cast<long>(value));
+			});
+			threads.emplace_back([&]() {
+				ready++;
+				while (!start.load()) std::this_thread::yield();
+				long sum = 0;
+				for (size_t count = 0; count < perThread; count++) sum += pop();
+				checksum += sum;
+			});
+		}
+		while (ready.load() != pairs * 2) std::this_thread::yield();
+		cs_std::timestamp time;
+		start.store(true);
+		threads.clear();
+		double seconds = time.elapsed();
+		// Every value pushed must come out exactly once
+		long expected = static_cast<long>(pairs * (perThread * (perThread - 1) / 2));
+		if (checksum.load() != expected)
+		{
+			std::printf("checksum mismatch, %ld instead of %ld\n", checksum.load(), expected);
+			std::exit(1);
+		}
+		return static_cast<double>(pairs * perThread) / seconds / 1e6;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::printf("%zu items, capacity %zu, %u hardware threads\n", items, CAPACITY, std::thread::hardware_concurrency());
+	std::printf("%8s%16s%22s\n", "pairs", "mpmc_queue", "thread_safe_queue");
+	for (size_t pairs : { 1, 4, 16, 64 })
+	{
+		size_t perThread = std::max<size_t>(items / pairs, 1);
+		cs_std::mpmc_queue<long, CAPACITY> lockFree;
+		double lockFreeRate = measure(pairs, perThread, [&](long value) { lockFree.push(value); }, [&]() { return lockFree.pop(); });
+		cs_std::thread_safe_queue<long> locked;
+		double lockedRate = measure(pairs, perThread, [&](long value) { locked.push(value); }, [&]() { return locked.pop().value(); });
+		std::printf("%8zu%10.1f Mops/s%16.1f Mops/s\n", pairs, lockFreeRate, lockedRate);
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+// Memory bandwidth of task_queue workers placed per NUMA node against unplaced workers
+// Usage: numa_benchmark [MiB per node], runs a STREAM style triad over arrays first touched by workers of each node
+// Build alongside cs_std, for example: g++ -std=c++20 -O2 -I../cs_std numa_benchmark.cpp ../cs_std/cpu_topology.cpp ../cs_std/math/random.cpp -pthread -o numa_benchmark
+#include <memory>
+#include <vector>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "timestamp.hpp"
+#include "task_queue.hpp"
+#include "cpu_topology.hpp"
+
+namespace
+{
+	// Elements per task, large enough that scheduling is noise next to the memory traffic
+	constexpr size_t CHUNK = 64 * 1024;
+	constexpr size_t PASSES = 5;
+
+	// One node's share of the arrays, the pages land on whichever node first writes them
+	struct block
+	{
+		size_t node;
+		size_t size;
+		std::unique_ptr<double[]> a;
+		std::unique_ptr<double[]> b;
+		std::unique_ptr<double[]> c;
+
+		block(size_t node, size_t size) : node(node), size(size), a(std::make_unique_for_overwrite<double[]>(size)), b(std::make_unique_for_overwrite<double[]>(size)), c(std::make_unique_for_overwrite<double[]>(size)) {}
+	};
+
+	// Pushes one task per chunk of every block, with the block's node as hint if placed, then waits for them
+	template<typename F>
+	void for_each_chunk(cs_std::task_queue& queue, std::vector<block>& blocks, bool placed, F function)
+	{
+		for (block& data : blocks)
+		{
+			for (size_t start = 0; start < data.size; start += CHUNK)
+			{
+				size_t end = std::min(start + CHUNK, data.size);
+				if (placed) queue.push_back_to_node([&data, start, end, function]() { function(data, start, end); }, data.node);
+				else queue.push_back([&data, start, end, function]() { function(data, start, end); });
+			}
+		}
+		queue.wait_till_finished();
+	}
+	// Best of several triad passes in GB/s, counting two reads and one write per element
+	double triad(cs_std::task_queue& queue, std::vector<block>& blocks, bool placed)
+	{
+		size_t elements = 0;
+		for (const block& data : blocks) elements += data.size;
+		double best = 0.0;
+		for (size_t pass = 0; pass < PASSES; pass++)
+		{
+			cs_std::timestamp time;
+			for_each_chunk(queue, blocks, placed, [](block& data, size_t start, size_t end) {
+				for (size_t i = start; i < end; i++) data.a[i] = data.b[i] + 3.0 * data.c[i];
+			});
+			best = std::max(best, static_cast<double>(elements * 3 * sizeof(double)) / time.elapsed() / 1e9);
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t mebibytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 384;
+	cs_std::cpu_topology topology = cs_std::cpu_topology::detect();
+	std::printf("%zu NUMA nodes, %zu CPUs, %zu MiB per node\n", topology.nodes.size(), topology.cpu_count(), mebibytes);
+	if (topology.nodes.size() < 2) std::printf("Single node machine, every mode reads local memory so the results should match\n");
+
+	std::vector<block> blocks;
+	size_t perNode = std::max<size_t>(mebibytes * 1024 * 1024 / (3 * sizeof(double)), CHUNK);
+	for (size_t node = 0; node < topology.nodes.size(); node++) blocks.emplace_back(node, perNode);
+	{
+		// First touch from the workers of each node puts every block's pages on its own node
+		cs_std::task_queue queue(std::numeric_limits<size_t>::max(), cs_std::scheduling_mode::fifo, cs_std::thread_affinity::per_node);
+		for_each_chunk(queue, blocks, true, [](block& data, size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+			{
+				data.a[i] = 0.0;
+				data.b[i] = 1.0;
+				data.c[i] = 2.0;
+			}
+		});
+		std::printf("%-40s%8.2f GB/s\n", "per_node workers, node hinted tasks", triad(queue, blocks, true));
+	}
+	{
+		cs_std::task_queue queue(std::numeric_limits<size_t>::max(), cs_std::scheduling_mode::fifo, cs_std::thread_affinity::per_core);
+		std::printf("%-40s%8.2f GB/s\n", "per_core workers, node hinted tasks", triad(queue, blocks, true));
+	}
+	{
+		cs_std::task_queue queue(std::numeric_limits<size_t>::max(), cs_std::scheduling_mode::fifo, cs_std::thread_affinity::none);
+		std::printf("%-40s%8.2f GB/s\n", "unplaced workers, unhinted tasks", triad(queue, blocks, false));
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+// Compares cs_std::task in a ring buffer queue with std::function in a std::queue, the path task_queue used before
+// Usage: task_benchmark [tasks], prints time and heap allocations per task for each path
+// Build alongside cs_std, for example: g++ -std=c++20 -O2 -I../cs_std task_benchmark.cpp ../cs_std/cpu_topology.cpp ../cs_std/math/random.cpp -pthread -o task_benchmark
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include "task.hpp"
+#include "task_queue.hpp"
+#include "timestamp.hpp"
+#include "thread_safe_queue.hpp"
+
+namespace
+{
+	std::atomic<size_t> allocations = 0;
+	// Tasks are pushed and drained in batches of this size, about what a busy producer has queued at once
+	constexpr size_t BATCH = 1000;
+
+	template<size_t Size>
+	struct capture
+	{
+		char bytes[Size];
+	};
+
+	void report(const char* name, size_t tasks, double seconds, size_t allocated)
+	{
+		std::printf("%-44s%10.1f ns/task%10.3f allocations/task\n", name, seconds * 1e9 / static_cast<double>(tasks), static_cast<double>(allocated) / static_cast<double>(tasks));
+	}
+	// Pushes and drains every task through the given queue on one thread so only the task type and container are measured
+	template<typename Function, typename Queue, size_t Size>
+	void run_queue(const char* name, size_t tasks)
+	{
+		Queue queue;
+		capture<Size> data = {};
+		std::atomic<size_t> sink = 0;
+		// One warm up round so the containers have grown to their steady state size
+		for (size_t i = 0; i < BATCH; i++) queue.push(Function([data, &sink]() { sink.fetch_add(static_cast<size_t>(data.bytes[0]), std::memory_order_relaxed); }));
+		while (queue.try_pop()) {}
+		size_t before = allocations.load();
+		cs_std::timestamp time;
+		for (size_t done = 0; done < tasks; done += BATCH)
+		{
+			for (size_t i = 0; i < BATCH; i++) queue.push(Function([data, &sink]() { sink.fetch_add(static_cast<size_t>(data.bytes[0]), std::memory_order_relaxed); }));
+			while (auto function = queue.try_pop()) (*function)();
+		}
+		report(name, tasks, time.elapsed(), allocations.load() - before);
+	}
+	template<size_t Size>
+	void run_task_queue(const char* name, size_t tasks)
+	{
+		cs_std::task_queue queue(1);
+		capture<Size> data = {};
+		std::atomic<size_t> sink = 0;
+		for (size_t i = 0; i < BATCH; i++) queue.push_back([data, &sink]() { sink.fetch_add(static_cast<size_t>(data.bytes[0]), std::memory_order_relaxed); });
+		queue.wait_till_finished();
+		size_t before = allocations.load();
+		cs_std::timestamp time;
+		for (size_t done = 0; done < tasks; done += BATCH)
+		{
+			for (size_t i = 0; i < BATCH; i++) queue.push_back([data, &sink]() { sink.fetch_add(static_cast<size_t>(data.bytes[0]), std::memory_order_relaxed); });
+			queue.wait_till_finished();
+		}
+		report(name, tasks, time.elapsed(), allocations.load() - before);
+	}
+	template<size_t Size>
+	void run_all(size_t tasks)
+	{
+		std::printf("%zu byte capture\n", Size);
+		run_queue<std::function<void()>, cs_std::thread_safe_queue<std::function<void()>>, Size>("  std::function + std::queue", tasks);
+		run_queue<cs_std::task, cs_std::thread_safe_ring_queue<cs_std::task>, Size>("  cs_std::task + ring_buffer", tasks);
+		run_task_queue<Size>("  task_queue push_back + wait, 1 thread", tasks);
+	}
+}
+
+// Counts every allocation made through the global operator new
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size != 0 ? size : 1)) return memory;
+	throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+int main(int argc, char** argv)
+{
+	size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	tasks = std::max<size_t>((tasks + BATCH - 1) / BATCH * BATCH, BATCH);
+	run_all<8>(tasks);
+	run_all<48>(tasks);
+	return 0;
+}
@@ -0,0 +1,171 @@
+// Checks that waits called from inside task_queue tasks never wait on each other, on fixed pools of several sizes
+// Usage: task_queue_waits, prints each case and exits with 1 if any case fails or hangs
+// Build alongside cs_std, for example: g++ -std=c++20 -I../cs_std task_queue_waits.cpp ../cs_std/cpu_topology.cpp ../cs_std/math/random.cpp -pthread -o task_queue_waits
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include "task_queue.hpp"
+
+namespace
+{
+	constexpr size_t FILLER_TASKS = 200;
+
+	// Kills the process if a case deadlocks instead of letting it hang
+	class watchdog
+	{
+	private:
+		std::atomic<bool> done = false;
+		std::jthread thread;
+	public:
+		explicit watchdog(const char* name) : thread([this, name]() {
+			std::chrono::steady_clock::time_point limit = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (!this->done.load())
+			{
+				if (std::chrono::steady_clock::now() > limit)
+				{
+					std::printf("%s: FAILED, still waiting after 10s\n", name);
+					std::fflush(stdout);
+					std::_Exit(1);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}) {}
+		~watchdog() { this->done.store(true); }
+	};
+
+	// A thread count is capped at the machine's cores, equal limits start exactly the requested threads anywhere
+	cs_std::elastic_threads pool(size_t threads) { return cs_std::elastic_threads{ threads, threads }; }
+	bool check(const char* name, bool passed)
+	{
+		std::printf("%s: %s\n", name, passed ? "ok" : "FAILED");
+		return passed;
+	}
+	void push_filler(cs_std::task_queue& queue, std::atomic<size_t>& ran)
+	{
+		for (size_t i = 0; i < FILLER_TASKS; i++) queue.push_back([&ran]() { ran++; std::this_thread::yield(); });
+	}
+
+	// The cases below rely on a fixed pool running its threads at once, each one is held until all of them are running a task
+	bool fixed(size_t threads)
+	{
+		char name[96];
+		std::snprintf(name, sizeof(name), "fixed pool of %zu threads", threads);
+		watchdog guard(name);
+		cs_std::task_queue queue(pool(threads));
+		std::atomic<size_t> running = 0;
+		for (size_t i = 0; i < threads; i++)
+		{
+			queue.push_back([&]() {
+				running++;
+				while (running.load() < threads) std::this_thread::yield();
+			});
+		}
+		queue.wait_till_finished();
+		return check(name, !queue.is_elastic() && queue.thread_count() == threads && queue.thread_limits().maxThreads == threads);
+	}
+
+	// Each waiting task must return only once every filler task has run
+	// The first ones are held until each pool thread has one, so they wait on different threads rather than running each other inside a wait
+	bool waiters(size_t threads, cs_std::scheduling_mode mode, size_t waiterCount)
+	{
+		char name[96];
+		std::snprintf(name, sizeof(name), "%zu waiting tasks, %zu threads, %s", waiterCount, threads, mode == cs_std::scheduling_mode::fifo ? "fifo" : "work stealing");
+		watchdog guard(name);
+		cs_std::task_queue queue(pool(threads), mode);
+		std::atomic<size_t> ran = 0;
+		std::atomic<size_t> early = 0;
+		std::atomic<size_t> started = 0;
+		for (size_t i = 0; i < waiterCount; i++)
+		{
+			queue.push_back([&]() {
+				started++;
+				while (started.load() < std::min(waiterCount, threads)) std::this_thread::yield();
+				push_filler(queue, ran);
+				queue.wait_till_finished();
+				if (ran.load() != FILLER_TASKS * waiterCount) early++;
+			});
+		}
+		queue.wait_till_finished();
+		return check(name, early.load() == 0 && ran.load() == FILLER_TASKS * waiterCount);
+	}
+
+	// A task helping inside a handle wait picks up a task that waits for the whole queue, the outer task is beneath it on the stack
+	bool nested(size_t threads)
+	{
+		char name[96];
+		std::snprintf(name, sizeof(name), "wait inside a handle wait, %zu threads", threads);
+		watchdog guard(name);
+		cs_std::task_queue queue(pool(threads), cs_std::scheduling_mode::fifo);
+		std::atomic<size_t> ran = 0;
+		std::atomic<bool> inner = false;
+		queue.push_back([&]() {
+			queue.push_back([&]() {
+				push_filler(queue, ran);
+				queue.wait_till_finished();
+				inner.store(true);
+			});
+			// Queued behind the waiting task so helping picks that up first
+			queue.wait(queue.submit([]() {}));
+		});
+		queue.wait_till_finished();
+		return check(name, inner.load() && ran.load() == FILLER_TASKS);
+	}
+
+	// A thread outside the pool helping in wait_for runs a task that waits for the whole queue, that task must not wait on itself
+	// Every worker is held until the waiting task has started so only the outside thread can have picked it up
+	bool outside(size_t threads)
+	{
+		char name[96];
+		std::snprintf(name, sizeof(name), "wait inside an outside thread's wait_for, %zu threads", threads);
+		watchdog guard(name);
+		cs_std::task_queue queue(pool(threads), cs_std::scheduling_mode::fifo);
+		std::atomic<size_t> ran = 0;
+		std::atomic<size_t> held = 0;
+		std::atomic<bool> started = false;
+		std::atomic<bool> inner = false;
+		std::atomic<bool> onCaller = false;
+		for (size_t i = 0; i < threads; i++)
+		{
+			queue.push_back([&]() {
+				held++;
+				while (!started.load()) std::this_thread::yield();
+			});
+		}
+		while (held.load() != threads) std::this_thread::yield();
+		std::thread::id caller = std::this_thread::get_id();
+		queue.push_back([&]() {
+			onCaller.store(std::this_thread::get_id() == caller);
+			started.store(true);
+			push_filler(queue, ran);
+			queue.wait_till_finished();
+			inner.store(true);
+		});
+		queue.wait_for([&]() { return inner.load(); });
+		queue.wait_till_finished();
+		return check(name, onCaller.load() && ran.load() == FILLER_TASKS);
+	}
+}
+
+int main()
+{
+	bool passed = true;
+	for (size_t threads : { 1, 2, 4 }) passed &= fixed(threads);
+	for (cs_std::scheduling_mode mode : { cs_std::scheduling_mode::fifo, cs_std::scheduling_mode::work_stealing })
+	{
+		for (size_t threads : { 1, 2, 4 })
+		{
+			passed &= waiters(threads, mode, 1);
+			passed &= waiters(threads, mode, 2);
+			passed &= waiters(threads, mode, 8);
+		}
+	}
+	for (size_t threads : { 1, 2 })
+	{
+		passed &= nested(threads);
+		passed &= outside(threads);
+	}
+	return passed ? 0 : 1;
+}